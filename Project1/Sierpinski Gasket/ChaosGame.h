@@ -0,0 +1,316 @@
+///////////////////////////////////////////////////////////////
+// ChaosGame.h
+//
+// Draws an IFS attractor such as the gasket by the chaos game: a point
+// jumps half way towards a corner picked at random, over and over, and
+// every place it lands is counted in the pixel it falls in. The counts
+// are log tone mapped into a texture drawn as one quad, so the detail
+// only grows with the time spent and the memory stays one counter per
+// pixel per thread.
+//
+// Every thread moves eight points of its own with its own xoshiro256+
+// generator, four 64 bit lanes each giving two 32 bit draws per step,
+// and counts into its own histogram; the histograms are merged when the
+// texture is made. On x86 CPUs with AVX2 the eight points and the four
+// generator lanes live in vector registers; elsewhere, ARM included,
+// the same arithmetic runs lane by lane, so both give the same picture.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef CHAOS_GAME_H
+#define CHAOS_GAME_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CHAOS_GAME_X86
+#include <immintrin.h>
+#endif
+
+#include <GL/glew.h>
+
+#include "ParallelSubdivide.h"
+
+struct ChaosGame
+{
+	bool vectorized = false; // Use the AVX2 path, set by create when the CPU has it.
+
+	// Counters for a width x height window showing -1 to 1 on both axes, one set per slot (thread),
+	// and the corners the point jumps towards, at most eight. A minimized window reports a size of zero,
+	// which gets one pixel so there is always a bin to count into and a row to take the peak of.
+	void create(int width, int height, unsigned slots, const float (*corners)[2], int cornerCount)
+	{
+		destroy();
+		width = std::max(width, 1);
+		height = std::max(height, 1);
+		this->width = width;
+		this->height = height;
+		this->cornerCount = cornerCount;
+		for (int c = 0; c < 8; c++)
+		{
+			cornerX[c] = corners[std::min(c, cornerCount - 1)][0];
+			cornerY[c] = corners[std::min(c, cornerCount - 1)][1];
+		}
+		this->slots.assign(slots, Slot());
+		for (Slot& slot : this->slots)
+		{
+			slot.bins.assign((size_t)width * height, 0);
+		}
+		merged.assign((size_t)width * height, 0);
+		pixels.assign((size_t)width * height * 4, 255);
+#ifdef CHAOS_GAME_X86
+		vectorized = __builtin_cpu_supports("avx2");
+#else
+		vectorized = false;
+#endif
+		clear();
+
+		glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Forget every point counted and seed the generators again.
+	void clear()
+	{
+		uint64_t seed = 0x5EED5EED5EED5EEDull;
+		for (Slot& slot : slots)
+		{
+			std::fill(slot.bins.begin(), slot.bins.end(), 0u);
+			for (int k = 0; k < 4; k++)
+			{
+				for (int lane = 0; lane < 4; lane++)
+				{
+					slot.state[k][lane] = splitMix64(seed);
+				}
+			}
+			for (int lane = 0; lane < 8; lane++)
+			{
+				slot.x[lane] = slot.y[lane] = 0.0f;
+			}
+			slot.warmup = 32; // after 32 jumps a point is within 2^-32 of the attractor
+		}
+		counted = 0;
+	}
+
+	// Moves the eight points of every slot steps times, each slot on its own thread.
+	void run(size_t steps)
+	{
+		parallelTasks(slots.size(), (unsigned)slots.size(), [&](size_t s)
+		{
+#ifdef CHAOS_GAME_X86
+			if (vectorized)
+			{
+				runAvx2(slots[s], steps);
+				return;
+			}
+#endif
+			runScalar(slots[s], steps);
+		});
+		counted += (uint64_t)steps * 8 * slots.size();
+	}
+
+	// Points counted since the last clear.
+	uint64_t points() const
+	{
+		return counted;
+	}
+
+	// Merge the slots, tone map and upload the texture: white where nothing landed, black where most did.
+	void resolve()
+	{
+		std::vector<uint32_t> rowMax(height, 0);
+		parallelTasks(height, (unsigned)slots.size(), [&](size_t row)
+		{
+			uint32_t* dst = merged.data() + row * width;
+			std::fill(dst, dst + width, 0u);
+			for (const Slot& slot : slots)
+			{
+				const uint32_t* src = slot.bins.data() + row * width;
+				for (int c = 0; c < width; c++)
+				{
+					dst[c] += src[c];
+				}
+			}
+			rowMax[row] = *std::max_element(dst, dst + width);
+		});
+		uint32_t peak = *std::max_element(rowMax.begin(), rowMax.end());
+
+		// Log scale so the thin parts of the attractor stay visible next to the dense ones.
+		float scale = peak > 0 ? 1.0f / std::log(1.0f + (float)peak) : 0.0f;
+		for (size_t i = 0; i < merged.size(); i++)
+		{
+			unsigned char shade = (unsigned char)(255.0f * (1.0f - std::log(1.0f + (float)merged[i]) * scale));
+			pixels[4 * i] = pixels[4 * i + 1] = pixels[4 * i + 2] = shade;
+			pixels[4 * i + 3] = 255;
+		}
+
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Draw the texture over the square from -1 to 1 the points were counted in.
+	void draw() const
+	{
+		glEnable(GL_TEXTURE_2D);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glColor3f(1.0, 1.0, 1.0);
+		glBegin(GL_QUADS);
+		glTexCoord2f(0.0, 0.0); glVertex2f(-1.0, -1.0);
+		glTexCoord2f(1.0, 0.0); glVertex2f(1.0, -1.0);
+		glTexCoord2f(1.0, 1.0); glVertex2f(1.0, 1.0);
+		glTexCoord2f(0.0, 1.0); glVertex2f(-1.0, 1.0);
+		glEnd();
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glDisable(GL_TEXTURE_2D);
+	}
+
+	void destroy()
+	{
+		glDeleteTextures(1, &texture);
+		texture = 0;
+	}
+
+private:
+	// One thread's points, generator and histogram.
+	struct Slot
+	{
+		uint64_t state[4][4]; // xoshiro256+ words s0 to s3, four lanes each
+		float x[8], y[8];     // 32 bit draw j comes from half j % 2 of lane j / 2, low half first
+		int warmup;           // Jumps left before landings are counted
+		std::vector<uint32_t> bins;
+	};
+
+	int width = 0, height = 0;
+	int cornerCount = 3;
+	float cornerX[8], cornerY[8]; // unused entries repeat the last corner
+	std::vector<Slot> slots;
+	std::vector<uint32_t> merged;
+	std::vector<unsigned char> pixels;
+	GLuint texture = 0;
+	uint64_t counted = 0;
+
+	static uint64_t splitMix64(uint64_t& seed)
+	{
+		uint64_t z = (seed += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// Counts the landings of lanes 0 to 7 whose histogram index is in pixel.
+	void count(Slot& slot, const int32_t* pixel)
+	{
+		if (slot.warmup > 0)
+		{
+			slot.warmup--;
+			return;
+		}
+		for (int lane = 0; lane < 8; lane++)
+		{
+			slot.bins[pixel[lane]]++;
+		}
+	}
+
+	void runScalar(Slot& slot, size_t steps)
+	{
+		float halfW = 0.5f * width, halfH = 0.5f * height;
+		for (size_t step = 0; step < steps; step++)
+		{
+			int32_t pixel[8];
+			for (int lane = 0; lane < 4; lane++)
+			{
+				uint64_t& s0 = slot.state[0][lane];
+				uint64_t& s1 = slot.state[1][lane];
+				uint64_t& s2 = slot.state[2][lane];
+				uint64_t& s3 = slot.state[3][lane];
+				uint64_t result = s0 + s3;
+				uint64_t t = s1 << 17;
+				s2 ^= s0;
+				s3 ^= s1;
+				s1 ^= s2;
+				s0 ^= s3;
+				s2 ^= t;
+				s3 = (s3 << 45) | (s3 >> 19);
+
+				for (int half = 0; half < 2; half++)
+				{
+					int j = lane * 2 + half;
+					uint32_t draw = (uint32_t)(result >> (32 * half));
+					int corner = (int)(((draw >> 8) * (uint32_t)cornerCount) >> 24);
+					slot.x[j] = (slot.x[j] + cornerX[corner]) * 0.5f;
+					slot.y[j] = (slot.y[j] + cornerY[corner]) * 0.5f;
+					int px = std::min(std::max((int)((slot.x[j] + 1.0f) * halfW), 0), width - 1);
+					int py = std::min(std::max((int)((slot.y[j] + 1.0f) * halfH), 0), height - 1);
+					pixel[j] = py * width + px;
+				}
+			}
+			count(slot, pixel);
+		}
+	}
+
+#ifdef CHAOS_GAME_X86
+	__attribute__((target("avx2")))
+	void runAvx2(Slot& slot, size_t steps)
+	{
+		__m256i s0 = _mm256_loadu_si256((const __m256i*)slot.state[0]);
+		__m256i s1 = _mm256_loadu_si256((const __m256i*)slot.state[1]);
+		__m256i s2 = _mm256_loadu_si256((const __m256i*)slot.state[2]);
+		__m256i s3 = _mm256_loadu_si256((const __m256i*)slot.state[3]);
+		__m256 x = _mm256_loadu_ps(slot.x);
+		__m256 y = _mm256_loadu_ps(slot.y);
+		const __m256 cx = _mm256_loadu_ps(cornerX);
+		const __m256 cy = _mm256_loadu_ps(cornerY);
+		const __m256i corners = _mm256_set1_epi32(cornerCount);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 halfW = _mm256_set1_ps(0.5f * width);
+		const __m256 halfH = _mm256_set1_ps(0.5f * height);
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i maxX = _mm256_set1_epi32(width - 1);
+		const __m256i maxY = _mm256_set1_epi32(height - 1);
+		const __m256i rowLength = _mm256_set1_epi32(width);
+
+		for (size_t step = 0; step < steps; step++)
+		{
+			// xoshiro256+ on four 64 bit lanes
+			__m256i result = _mm256_add_epi64(s0, s3);
+			__m256i t = _mm256_slli_epi64(s1, 17);
+			s2 = _mm256_xor_si256(s2, s0);
+			s3 = _mm256_xor_si256(s3, s1);
+			s1 = _mm256_xor_si256(s1, s2);
+			s0 = _mm256_xor_si256(s0, s3);
+			s2 = _mm256_xor_si256(s2, t);
+			s3 = _mm256_or_si256(_mm256_slli_epi64(s3, 45), _mm256_srli_epi64(s3, 19));
+
+			// Top 24 bits of each 32 bit half pick the corner, then every point jumps half way to its corner.
+			__m256i corner = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(result, 8), corners), 24);
+			x = _mm256_mul_ps(_mm256_add_ps(x, _mm256_permutevar8x32_ps(cx, corner)), half);
+			y = _mm256_mul_ps(_mm256_add_ps(y, _mm256_permutevar8x32_ps(cy, corner)), half);
+
+			__m256i px = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(x, one), halfW)), zero), maxX);
+			__m256i py = _mm256_min_epi32(_mm256_max_epi32(_mm256_cvttps_epi32(_mm256_mul_ps(_mm256_add_ps(y, one), halfH)), zero), maxY);
+			alignas(32) int32_t pixel[8];
+			_mm256_store_si256((__m256i*)pixel, _mm256_add_epi32(_mm256_mullo_epi32(py, rowLength), px));
+			count(slot, pixel);
+		}
+
+		_mm256_storeu_si256((__m256i*)slot.state[0], s0);
+		_mm256_storeu_si256((__m256i*)slot.state[1], s1);
+		_mm256_storeu_si256((__m256i*)slot.state[2], s2);
+		_mm256_storeu_si256((__m256i*)slot.state[3], s3);
+		_mm256_storeu_ps(slot.x, x);
+		_mm256_storeu_ps(slot.y, y);
+	}
+#endif
+};
+
+#endif
@@ -0,0 +1,330 @@
+///////////////////////////////////////////////////////////////
+// FractalEngine.h
+//
+// Generates fractals described either as a set of affine maps (an
+// iterated function system) or as an L-system grammar, into buffers
+// of interleaved position and color vertices ready to draw in one
+// call. A fractal is a small struct describing it; the expansion is a
+// template over that struct, so the map count, the size of the base
+// shape and the rules are compile time constants and each fractal gets
+// its own expansion code with the loops over them unrolled.
+//
+// IFS fractals copy a base shape through every composition of depth
+// maps. The number of leaves is known up front, so the top levels are
+// split across cores like the gasket generators, each task writing its
+// own slice of the buffer. L-system fractals are drawn by a turtle
+// walking the expanded grammar without ever building the string.
+// Both can also be handed out vertex by vertex instead of into a
+// buffer, which is how FractalExport.h streams levels too big to hold.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef FRACTAL_ENGINE_H
+#define FRACTAL_ENGINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ParallelSubdivide.h"
+
+// One vertex of a generated buffer, position then color. Flat fractals have z = 0.
+struct FractalVertex
+{
+	float x, y, z;
+	float r, g, b;
+};
+
+// The map p -> m p + t.
+struct AffineMap
+{
+	float m[3][3];
+	float t[3];
+};
+
+inline AffineMap identityMap()
+{
+	return { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } }, { 0, 0, 0 } };
+}
+
+// Shrinks everything by s towards the point (x, y, z), s = 1/2 is one of the gasket's maps.
+inline AffineMap scaleTowards(float s, float x, float y, float z)
+{
+	return { { { s, 0, 0 }, { 0, s, 0 }, { 0, 0, s } }, { (1 - s) * x, (1 - s) * y, (1 - s) * z } };
+}
+
+// Scales by s, turns by degrees about the z axis, then moves by (x, y).
+inline AffineMap similarity2D(float s, float degrees, float x, float y)
+{
+	float c = s * (float)cos(degrees * M_PI / 180.0), n = s * (float)sin(degrees * M_PI / 180.0);
+	return { { { c, -n, 0 }, { n, c, 0 }, { 0, 0, 1 } }, { x, y, 0 } };
+}
+
+// Maps the segment from (0, 0) to (1, 0) onto the segment from (x1, y1) to (x2, y2), turning without stretching.
+inline AffineMap segmentMap(float x1, float y1, float x2, float y2)
+{
+	float dx = x2 - x1, dy = y2 - y1;
+	return { { { dx, -dy, 0 }, { dy, dx, 0 }, { 0, 0, 1 } }, { x1, y1, 0 } };
+}
+
+// a applied after b.
+inline AffineMap compose(const AffineMap& a, const AffineMap& b)
+{
+	AffineMap r;
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+		}
+		r.t[i] = a.m[i][0] * b.t[0] + a.m[i][1] * b.t[1] + a.m[i][2] * b.t[2] + a.t[i];
+	}
+	return r;
+}
+
+inline FractalVertex apply(const AffineMap& a, const FractalVertex& v)
+{
+	FractalVertex r = v;
+	r.x = a.m[0][0] * v.x + a.m[0][1] * v.y + a.m[0][2] * v.z + a.t[0];
+	r.y = a.m[1][0] * v.x + a.m[1][1] * v.y + a.m[1][2] * v.z + a.t[1];
+	r.z = a.m[2][0] * v.x + a.m[2][1] * v.y + a.m[2][2] * v.z + a.t[2];
+	return r;
+}
+
+// An IFS fractal is a struct with
+//   static constexpr int mapCount, baseCount;
+//   static const AffineMap* maps();        mapCount maps, the first one leads to the first leaves
+//   static const FractalVertex* base();    baseCount vertices copied to every leaf
+
+// Leaves of Fractal at depth, mapCount^depth. Count is double for depths whose count overflows size_t.
+template <class Fractal, class Count = size_t>
+Count ifsLeaves(int depth)
+{
+	Count leaves = 1;
+	for (int level = 0; level < depth; level++)
+	{
+		leaves *= Fractal::mapCount;
+	}
+	return leaves;
+}
+
+template <class Fractal, class Count = size_t>
+Count ifsVertexCount(int depth)
+{
+	return ifsLeaves<Fractal, Count>(depth) * Fractal::baseCount;
+}
+
+// Writes the leaves of the subtree under transform, depth levels and leaves leaves deep, depth first into out.
+template <class Fractal>
+void expandIfsSubtree(const AffineMap& transform, int depth, size_t leaves, FractalVertex* out)
+{
+	if (depth == 0)
+	{
+		const FractalVertex* base = Fractal::base();
+		for (int v = 0; v < Fractal::baseCount; v++)
+		{
+			out[v] = apply(transform, base[v]);
+		}
+		return;
+	}
+	const AffineMap* maps = Fractal::maps();
+	size_t child = leaves / Fractal::mapCount;
+	for (int k = 0; k < Fractal::mapCount; k++)
+	{
+		expandIfsSubtree<Fractal>(compose(transform, maps[k]), depth - 1, child, out + k * child * Fractal::baseCount);
+	}
+}
+
+template <class Fractal, class Visit>
+void visitIfsSubtree(const AffineMap& transform, int depth, Visit& visit)
+{
+	if (depth == 0)
+	{
+		const FractalVertex* base = Fractal::base();
+		FractalVertex leaf[Fractal::baseCount];
+		for (int v = 0; v < Fractal::baseCount; v++)
+		{
+			leaf[v] = apply(transform, base[v]);
+		}
+		visit((const FractalVertex*)leaf);
+		return;
+	}
+	const AffineMap* maps = Fractal::maps();
+	for (int k = 0; k < Fractal::mapCount; k++)
+	{
+		visitIfsSubtree<Fractal>(compose(transform, maps[k]), depth - 1, visit);
+	}
+}
+
+// Calls visit(leaf) with the baseCount vertices of every leaf of Fractal at depth, in the order expandIfs
+// writes them, on the calling thread. Only one leaf and the maps down to it exist at a time, for streaming
+// levels too deep to hold.
+template <class Fractal, class Visit>
+void visitIfs(int depth, const AffineMap& root, Visit visit)
+{
+	visitIfsSubtree<Fractal>(root, depth, visit);
+}
+
+// Fills out with the ifsVertexCount<Fractal>(depth) vertices of Fractal at depth, with root applied last,
+// using threads threads. Each subtree below the split level is finished by its own task in its own slice
+// of out; the task works out the maps leading to its subtree from the digits of its number.
+template <class Fractal>
+void expandIfs(int depth, const AffineMap& root, FractalVertex* out, unsigned threads = subdivisionThreads())
+{
+	size_t leaves = ifsLeaves<Fractal>(depth);
+	size_t split = splitStride(leaves, Fractal::mapCount, threads);
+	int below = 0; // levels each task expands
+	for (size_t stride = split; stride > 1; stride /= Fractal::mapCount)
+	{
+		below++;
+	}
+	size_t tasks = leaves / split;
+	parallelTasks(tasks, threads, [&](size_t task)
+	{
+		const AffineMap* maps = Fractal::maps();
+		AffineMap transform = root;
+		for (size_t place = tasks / Fractal::mapCount; place > 0; place /= Fractal::mapCount)
+		{
+			transform = compose(transform, maps[(task / place) % Fractal::mapCount]); // most significant digit first
+		}
+		expandIfsSubtree<Fractal>(transform, below, split, out + task * split * Fractal::baseCount);
+	});
+}
+
+// An L-system fractal is a struct with
+//   static constexpr const char* axiom;
+//   static constexpr int angle;              degrees turned by + and -, a divisor of 360
+//   static constexpr const char* rule(char symbol);   what symbol becomes, or nullptr if it stays
+// F draws a step forward, + turns left, - turns right and every other symbol only takes part in the rules.
+
+// Segments drawn at depth, counted per symbol level by level without expanding anything.
+template <class System, class Count = size_t>
+Count lSystemSegments(int depth)
+{
+	std::vector<Count> counts(128, 0), next(128);
+	counts['F'] = 1;
+	for (int level = 0; level < depth; level++)
+	{
+		for (int symbol = 0; symbol < 128; symbol++)
+		{
+			const char* rule = System::rule((char)symbol);
+			if (rule == nullptr)
+			{
+				next[symbol] = counts[symbol];
+				continue;
+			}
+			next[symbol] = 0;
+			for (const char* c = rule; *c; c++)
+			{
+				next[symbol] += counts[(unsigned char)*c & 127];
+			}
+		}
+		counts.swap(next);
+	}
+	Count segments = 0;
+	for (const char* c = System::axiom; *c; c++)
+	{
+		segments += counts[(unsigned char)*c & 127];
+	}
+	return segments;
+}
+
+// Where the turtle is; heading counts turns of angle degrees so directions come from a table and never drift.
+struct Turtle
+{
+	double x, y;
+	int heading;
+};
+
+// Walks the turtle through symbols expanded depth more times, calling step(x, y) wherever it lands.
+template <class System, class Step>
+void walkLSymbols(const char* symbols, int depth, Turtle& turtle, const double* directions, Step& step)
+{
+	const int turns = 360 / System::angle;
+	for (const char* c = symbols; *c; c++)
+	{
+		const char* rule = depth > 0 ? System::rule(*c) : nullptr;
+		if (rule != nullptr)
+		{
+			walkLSymbols<System>(rule, depth - 1, turtle, directions, step);
+			continue;
+		}
+		switch (*c)
+		{
+		case 'F': // step forward
+			turtle.x += directions[turtle.heading * 2];
+			turtle.y += directions[turtle.heading * 2 + 1];
+			step(turtle.x, turtle.y);
+			break;
+		case '+': // turn left
+			turtle.heading = (turtle.heading + 1) % turns;
+			break;
+		case '-': // turn right
+			turtle.heading = (turtle.heading + turns - 1) % turns;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// Walks the whole path of System at depth from the origin, step(x, y) getting every point after the first.
+template <class System, class Step>
+void walkLSystem(int depth, Step step)
+{
+	static_assert(360 % System::angle == 0, "the turn angle must divide 360");
+	const int turns = 360 / System::angle;
+	std::vector<double> directions(turns * 2); // unit step for every heading
+	for (int i = 0; i < turns; i++)
+	{
+		directions[i * 2] = cos(i * System::angle * M_PI / 180.0);
+		directions[i * 2 + 1] = sin(i * System::angle * M_PI / 180.0);
+	}
+	Turtle turtle = { 0.0, 0.0, 0 };
+	walkLSymbols<System>(System::axiom, depth, turtle, directions.data(), step);
+}
+
+// Calls visit(vertex) for the lSystemSegments + 1 vertices of the path the turtle walks for System at depth,
+// a line strip fitted into the square from -0.9 to 0.9 and colored from blue at its start to red at its end.
+// The path is walked twice, once for its bounds and once to hand it out, so nothing of it is kept.
+template <class System, class Visit>
+void visitLSystem(int depth, Visit visit)
+{
+	float minX = 0, maxX = 0, minY = 0, maxY = 0;
+	walkLSystem<System>(depth, [&](double x, double y)
+	{
+		minX = std::min(minX, (float)x);
+		maxX = std::max(maxX, (float)x);
+		minY = std::min(minY, (float)y);
+		maxY = std::max(maxY, (float)y);
+	});
+	float scale = 1.8f / std::max(std::max(maxX - minX, maxY - minY), 1.0f);
+	float middleX = (minX + maxX) / 2, middleY = (minY + maxY) / 2;
+	size_t count = lSystemSegments<System>(depth) + 1, i = 0;
+	auto emit = [&](float x, float y)
+	{
+		float along = count > 1 ? (float)i / (count - 1) : 0.0f;
+		visit(FractalVertex{ (x - middleX) * scale, (y - middleY) * scale, 0, along, 0, 1 - along });
+		i++;
+	};
+	emit(0, 0);
+	walkLSystem<System>(depth, [&](double x, double y)
+	{
+		emit((float)x, (float)y);
+	});
+}
+
+// Fills out with the path visitLSystem hands out.
+template <class System>
+void expandLSystem(int depth, std::vector<FractalVertex>& out)
+{
+	out.clear();
+	out.reserve(lSystemSegments<System>(depth) + 1);
+	visitLSystem<System>(depth, [&](const FractalVertex& v)
+	{
+		out.push_back(v);
+	});
+}
+
+#endif
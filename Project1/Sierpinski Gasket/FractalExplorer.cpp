@@ -0,0 +1,527 @@
+///////////////////////////////////////////////////////////////
+// FractalExplorer.cpp
+//
+// This program shows every fractal of the project, and some more,
+// generated by FractalEngine.h: the Sierpinski triangle, tetrahedron
+// and Koch snowflake as sets of affine maps, the Dragon and Hilbert
+// curves as L-systems and the Menger sponge as 20 affine maps.
+//
+// With --export it writes one of them at any depth to an SVG, OBJ or
+// raw binary file through FractalExport.h instead of opening a window,
+// streaming it so the depth is only limited by the disk.
+//
+// Interaction:
+// Press 1 to 6 to choose the fractal.
+// Press the up arrow key to increase the number of fractals.
+// Press the down arrow key to decrease the number of fractals.
+// Press space bar to rotate the 3D fractals.
+// Press r to reset.
+//
+// COMPILE: g++ -o FractalExplorer FractalExplorer.cpp -lGLEW -lGL -lGLU -lglut -pthread
+//
+// RUN: ./FractalExplorer
+// EXPORT: ./FractalExplorer --export <1 to 6> <depth> <file.svg, file.obj or file.bin>
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <GL/glew.h>
+#include <GL/freeglut.h>
+
+#include "FractalEngine.h"
+#include "FractalExport.h"
+
+// Globals.
+static int fractal = 0; // Which fractal of the catalogue below is shown.
+static int fractals = 1; // Holds value for number of fractals.
+static float Angle = 0.0; // Angle to rotate the 3D fractals.
+static const size_t maxVertices = (size_t)1 << 22; // Deepest level shown is the last one under 4 million vertices, 96 MB.
+static GLuint vbo = 0; // The fractal being shown, interleaved position and color.
+static GLsizei vertexCount = 0;
+static int builtFractal = -1, builtDepth = -1; // What the buffer holds.
+
+// The Sierpinski triangle of SierpinskiTriangle2D.cpp: halve towards a, then c, then b.
+struct SierpinskiTriangle
+{
+	static constexpr int mapCount = 3, baseCount = 3;
+	static const AffineMap* maps()
+	{
+		static const AffineMap maps[3] = { scaleTowards(0.5f, -1, -1, 0), scaleTowards(0.5f, 1, -1, 0), scaleTowards(0.5f, 0, 1, 0) };
+		return maps;
+	}
+	static const FractalVertex* base()
+	{
+		static const FractalVertex base[3] = { { -1, -1, 0, 0, 0, 0 }, { 0, 1, 0, 0, 0, 0 }, { 1, -1, 0, 0, 0, 0 } };
+		return base;
+	}
+};
+
+// The gasket of SierpinskiTriangle3D.cpp: halve towards each corner, every face colored as it is there.
+struct SierpinskiTetrahedron
+{
+	static constexpr int mapCount = 4, baseCount = 12;
+	static const AffineMap* maps()
+	{
+		static const AffineMap maps[4] =
+		{
+			scaleTowards(0.5f, 0.0f, 1.0f, 0.0f),
+			scaleTowards(0.5f, -1.0f, -0.5f, -0.5f),
+			scaleTowards(0.5f, 1.0f, -0.5f, -0.5f),
+			scaleTowards(0.5f, 0.0f, -0.5f, 1.0f)
+		};
+		return maps;
+	}
+	static const FractalVertex* base()
+	{
+		static const FractalVertex base[12] =
+		{
+			// corners a, b, c red
+			{ 0.0f, 1.0f, 0.0f, 1, 0, 0 }, { -1.0f, -0.5f, -0.5f, 1, 0, 0 }, { 1.0f, -0.5f, -0.5f, 1, 0, 0 },
+			// corners a, b, d yellow
+			{ 0.0f, 1.0f, 0.0f, 1, 1, 0 }, { -1.0f, -0.5f, -0.5f, 1, 1, 0 }, { 0.0f, -0.5f, 1.0f, 1, 1, 0 },
+			// corners a, c, d magenta
+			{ 0.0f, 1.0f, 0.0f, 1, 0, 1 }, { 1.0f, -0.5f, -0.5f, 1, 0, 1 }, { 0.0f, -0.5f, 1.0f, 1, 0, 1 },
+			// corners b, c, d blue
+			{ -1.0f, -0.5f, -0.5f, 0, 0, 1 }, { 1.0f, -0.5f, -0.5f, 0, 0, 1 }, { 0.0f, -0.5f, 1.0f, 0, 0, 1 }
+		};
+		return base;
+	}
+};
+
+// One side of the snowflake of KochSnowflake2D.cpp: the segment from (0, 0) to (1, 0) and the four thirds
+// it is replaced by, the middle two raised into the peak on the left of the segment.
+struct KochCurve
+{
+	static constexpr int mapCount = 4, baseCount = 2;
+	static const AffineMap* maps()
+	{
+		static const AffineMap maps[4] =
+		{
+			similarity2D(1.0f / 3, 0, 0, 0),
+			similarity2D(1.0f / 3, 60, 1.0f / 3, 0),
+			similarity2D(1.0f / 3, -60, 0.5f, (float)(sqrt(3.0) / 6)),
+			similarity2D(1.0f / 3, 0, 2.0f / 3, 0)
+		};
+		return maps;
+	}
+	static const FractalVertex* base()
+	{
+		static const FractalVertex base[2] = { { 0, 0, 0, 1, 0, 0 }, { 1, 0, 0, 1, 0, 0 } };
+		return base;
+	}
+};
+
+// Menger sponge: the 20 of the 27 thirds of a cube that are not the middle of a face or of the cube.
+struct MengerSponge
+{
+	static constexpr int mapCount = 20, baseCount = 36;
+	static const AffineMap* maps()
+	{
+		// Built on first use, which the tasks of expandIfs may all make at once; a static's initializer runs only once.
+		static const std::vector<AffineMap> maps = []()
+		{
+			std::vector<AffineMap> thirds;
+			for (int i = -1; i <= 1; i++)
+			{
+				for (int j = -1; j <= 1; j++)
+				{
+					for (int k = -1; k <= 1; k++)
+					{
+						if ((i == 0) + (j == 0) + (k == 0) <= 1)
+						{
+							thirds.push_back({ { { 1.0f / 3, 0, 0 }, { 0, 1.0f / 3, 0 }, { 0, 0, 1.0f / 3 } }, { i * 2.0f / 3, j * 2.0f / 3, k * 2.0f / 3 } });
+						}
+					}
+				}
+			}
+			return thirds;
+		}();
+		return maps.data();
+	}
+	// The cube from -1 to 1 as twelve triangles, the faces across x red, across y yellow and across z blue.
+	static const FractalVertex* base()
+	{
+		static const std::vector<FractalVertex> base = []()
+		{
+			std::vector<FractalVertex> cube;
+			float colors[3][3] = { { 1, 0, 0 }, { 1, 1, 0 }, { 0, 0, 1 } };
+			int corners[6][2] = { { -1, -1 }, { 1, -1 }, { 1, 1 }, { -1, -1 }, { 1, 1 }, { -1, 1 } };
+			for (int axis = 0; axis < 3; axis++)
+			{
+				for (int side = -1; side <= 1; side += 2)
+				{
+					for (int v = 0; v < 6; v++)
+					{
+						float p[3];
+						p[axis] = (float)side;
+						p[(axis + 1) % 3] = (float)corners[v][0];
+						p[(axis + 2) % 3] = (float)corners[v][1];
+						cube.push_back({ p[0], p[1], p[2], colors[axis][0], colors[axis][1], colors[axis][2] });
+					}
+				}
+			}
+			return cube;
+		}();
+		return base.data();
+	}
+};
+
+// Heighway dragon: every fold of a strip of paper folded in half depth times.
+struct DragonCurve
+{
+	static constexpr const char* axiom = "FX";
+	static constexpr int angle = 90;
+	static constexpr const char* rule(char symbol)
+	{
+		return symbol == 'X' ? "X+YF+" : symbol == 'Y' ? "-FX-Y" : nullptr;
+	}
+};
+
+// Hilbert curve: visits every cell of a 2^depth by 2^depth grid once.
+struct HilbertCurve
+{
+	static constexpr const char* axiom = "A";
+	static constexpr int angle = 90;
+	static constexpr const char* rule(char symbol)
+	{
+		return symbol == 'A' ? "+BF-AFA-FB+" : symbol == 'B' ? "-AF+BFB+FA-" : nullptr;
+	}
+};
+
+// The three sides of the snowflake's initial triangle, the root of each side's Koch curve.
+static AffineMap kochSide(int side)
+{
+	float corners[4][2] = { { -0.6f, -0.35f }, { 0.6f, -0.35f }, { 0.0f, 0.65f }, { -0.6f, -0.35f } };
+	return segmentMap(corners[side][0], corners[side][1], corners[side + 1][0], corners[side + 1][1]);
+}
+
+void generateSierpinskiTriangle(int depth, std::vector<FractalVertex>& out)
+{
+	out.resize(ifsVertexCount<SierpinskiTriangle>(depth));
+	expandIfs<SierpinskiTriangle>(depth, identityMap(), out.data());
+}
+
+void generateSierpinskiTetrahedron(int depth, std::vector<FractalVertex>& out)
+{
+	out.resize(ifsVertexCount<SierpinskiTetrahedron>(depth));
+	expandIfs<SierpinskiTetrahedron>(depth, identityMap(), out.data());
+}
+
+void generateKochSnowflake(int depth, std::vector<FractalVertex>& out)
+{
+	size_t perSide = ifsVertexCount<KochCurve>(depth);
+	out.resize(3 * perSide);
+	for (int side = 0; side < 3; side++)
+	{
+		expandIfs<KochCurve>(depth, kochSide(side), out.data() + side * perSide);
+	}
+}
+
+void generateMengerSponge(int depth, std::vector<FractalVertex>& out)
+{
+	out.resize(ifsVertexCount<MengerSponge>(depth));
+	expandIfs<MengerSponge>(depth, identityMap(), out.data());
+}
+
+void generateDragonCurve(int depth, std::vector<FractalVertex>& out)
+{
+	expandLSystem<DragonCurve>(depth, out);
+}
+
+void generateHilbertCurve(int depth, std::vector<FractalVertex>& out)
+{
+	expandLSystem<HilbertCurve>(depth, out);
+}
+
+// The same vertices as the generate functions above, handed to the exporter one leaf at a time.
+template <class Fractal>
+void streamIfs(int depth, FractalExporter& out)
+{
+	visitIfs<Fractal>(depth, identityMap(), [&](const FractalVertex* leaf)
+	{
+		for (int v = 0; v < Fractal::baseCount; v++)
+		{
+			out.vertex(leaf[v]);
+		}
+	});
+}
+
+void streamKochSnowflake(int depth, FractalExporter& out)
+{
+	for (int side = 0; side < 3; side++)
+	{
+		visitIfs<KochCurve>(depth, kochSide(side), [&](const FractalVertex* leaf)
+		{
+			out.vertex(leaf[0]);
+			out.vertex(leaf[1]);
+		});
+	}
+}
+
+template <class System>
+void streamLSystem(int depth, FractalExporter& out)
+{
+	visitLSystem<System>(depth, [&](const FractalVertex& v)
+	{
+		out.vertex(v);
+	});
+}
+
+// What the explorer needs to know about each fractal.
+struct FractalEntry
+{
+	const char* name;
+	GLenum primitive;
+	bool solid; // 3D, drawn rotated with the depth test
+	double (*vertices)(int depth); // counted in double, the Menger sponge overflows size_t from depth 15
+	void (*generate)(int depth, std::vector<FractalVertex>& out);
+	void (*stream)(int depth, FractalExporter& out);
+};
+
+static const FractalEntry catalogue[6] =
+{
+	{ "Sierpinski triangle", GL_TRIANGLES, false, ifsVertexCount<SierpinskiTriangle, double>, generateSierpinskiTriangle, streamIfs<SierpinskiTriangle> },
+	{ "Sierpinski tetrahedron", GL_TRIANGLES, true, ifsVertexCount<SierpinskiTetrahedron, double>, generateSierpinskiTetrahedron, streamIfs<SierpinskiTetrahedron> },
+	{ "Koch snowflake", GL_LINES, false, [](int depth) { return 3 * ifsVertexCount<KochCurve, double>(depth); }, generateKochSnowflake, streamKochSnowflake },
+	{ "Dragon curve", GL_LINE_STRIP, false, [](int depth) { return lSystemSegments<DragonCurve, double>(depth) + 1; }, generateDragonCurve, streamLSystem<DragonCurve> },
+	{ "Hilbert curve", GL_LINE_STRIP, false, [](int depth) { return lSystemSegments<HilbertCurve, double>(depth) + 1; }, generateHilbertCurve, streamLSystem<HilbertCurve> },
+	{ "Menger sponge", GL_TRIANGLES, true, ifsVertexCount<MengerSponge, double>, generateMengerSponge, streamIfs<MengerSponge> }
+};
+
+// Drawing routine.
+void drawScene(void)
+{
+	const FractalEntry& entry = catalogue[fractal];
+	if (builtFractal != fractal || builtDepth != fractals)
+	{
+		// Regenerate and upload only when the fractal or the depth changes.
+		std::vector<FractalVertex> vertices;
+		entry.generate(fractals, vertices);
+		glBindBuffer(GL_ARRAY_BUFFER, vbo);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(FractalVertex), vertices.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		vertexCount = (GLsizei)vertices.size();
+		builtFractal = fractal;
+		builtDepth = fractals;
+	}
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	glLoadIdentity();
+	if (entry.solid)
+	{
+		// The 3D fractals span -1 to 1 on every axis, half size keeps every rotation inside the window.
+		glEnable(GL_DEPTH_TEST);
+		glScalef(0.5, 0.5, 0.5);
+		glRotatef(Angle, 1.0, 1.0, 0.5);
+	}
+	else
+	{
+		glDisable(GL_DEPTH_TEST);
+	}
+
+	// Every fractal is one draw call from the interleaved buffer.
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, sizeof(FractalVertex), (void*)0);
+	glColorPointer(3, GL_FLOAT, sizeof(FractalVertex), (void*)(3 * sizeof(float)));
+	glDrawArrays(entry.primitive, 0, vertexCount);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glutSwapBuffers();
+}
+
+// Initialization routine.
+void setup(void)
+{
+	glClearColor(1.0, 1.0, 1.0, 0.0);
+	glGenBuffers(1, &vbo);
+}
+
+// OpenGL window reshape routine.
+void resize(int w, int h)
+{
+	glViewport(0, 0, w, h);
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+}
+
+// Keyboard input processing routine.
+void keyInput(unsigned char key, int x, int y)
+{
+	switch (key)
+	{
+	case '1': case '2': case '3': case '4': case '5': case '6': // choose the fractal.
+		fractal = key - '1';
+		while (fractals > 0 && catalogue[fractal].vertices(fractals) > maxVertices)
+		{
+			fractals -= 1; // keep within the deepest level of the new fractal
+		}
+		std::cout << catalogue[fractal].name << "." << std::endl;
+		glutPostRedisplay();
+		break;
+	case 'r': // reset to original number of fractals.
+		fractals = 1;
+		Angle = 0;
+		glutPostRedisplay();
+		break;
+	case ' ':
+		Angle += 10.0;
+		if (Angle > 360.0)
+		{
+			Angle -= 360.0;
+		}
+		glutPostRedisplay();
+		break;
+	case 27: // escape will leave the program
+		exit(0);
+		break;
+	default:
+		break;
+	}
+}
+
+// Callback routine for non-ASCII key entry.
+void specialKeyInput(int key, int x, int y)
+{
+	if (key == GLUT_KEY_UP)
+	{
+		if (catalogue[fractal].vertices(fractals + 1) > maxVertices)
+		{
+			std::cout << "Deepest level of the " << catalogue[fractal].name << " is " << fractals << "." << std::endl;
+		}
+		else
+		{
+			fractals += 1; // increase number of fractals by 1
+		}
+	}
+	if (key == GLUT_KEY_DOWN)
+	{
+		if (fractals == 0)
+		{
+			fractals = 0; // if fractals is zero do not decrease it
+		}
+		else
+		{
+			fractals -= 1; // decrease number of fractals by 1
+		}
+	}
+	glutPostRedisplay();
+}
+
+// Routine to output interaction instructions to the C++ window.
+void printInteraction(void)
+{
+	std::cout << "Interaction:" << std::endl;
+	std::cout << "Press 1 to 6 to choose the fractal:" << std::endl;
+	for (int i = 0; i < 6; i++)
+	{
+		std::cout << "  " << i + 1 << " " << catalogue[i].name << std::endl;
+	}
+	std::cout << "Press the up arrow key to increase number of fractals." << std::endl
+		<< "Press the down arrow key to decrease number of fractals." << std::endl
+		<< "Press the space bar to rotate the 3D fractals." << std::endl
+		<< "Press r to reset." << std::endl;
+}
+
+static const char* exportUsage = "Usage: FractalExplorer --export <1 to 6> <depth> <file.svg, file.obj or file.bin>";
+static const double maxExportBytes = 1e12; // Exports expected to write more than a terabyte are refused.
+
+// Writes fractal number which (1 to 6) at depth to path for --export, returns the exit status.
+int exportFractal(const char* which, const char* depthText, const char* path)
+{
+	int index = atoi(which) - 1, depth = atoi(depthText);
+	FractalExporter::Format format;
+	if (index < 0 || index >= 6 || depth < 0)
+	{
+		std::cerr << exportUsage << std::endl;
+		return 1;
+	}
+	if (!FractalExporter::formatOf(path, format))
+	{
+		std::cerr << "The file name must end in .svg, .obj or .bin." << std::endl;
+		return 1;
+	}
+	const FractalEntry& entry = catalogue[index];
+	if (format == FractalExporter::Svg && entry.solid)
+	{
+		std::cerr << "The " << entry.name << " is 3D, export it as .obj or .bin." << std::endl;
+		return 1;
+	}
+
+	// Every fractal at least doubles its vertices each level, so past depth 64 it is over the limit anyway.
+	double bytes = entry.vertices(std::min(depth, 64)) * FractalExporter::bytesPerVertex(format);
+	if (bytes > maxExportBytes)
+	{
+		std::cerr << "The " << entry.name << " at depth " << depth << " would take about " << bytes / 1e12
+			<< " TB, more than the 1 TB export limit. Choose a smaller depth." << std::endl;
+		return 1;
+	}
+
+	FractalExporter::Shape shape = entry.primitive == GL_TRIANGLES ? FractalExporter::Triangles
+		: entry.primitive == GL_LINES ? FractalExporter::Lines : FractalExporter::LineStrip;
+	FractalExporter out;
+	if (!out.open(path, format, shape, entry.name))
+	{
+		std::cerr << "Cannot open " << path << "." << std::endl;
+		return 1;
+	}
+	std::cout << "Exporting the " << entry.name << " at depth " << depth << " to " << path << "." << std::endl;
+	entry.stream(depth, out);
+	if (!out.close())
+	{
+		std::cerr << "Writing " << path << " failed." << std::endl;
+		return 1;
+	}
+	std::cout << "Wrote " << out.vertices() << " vertices, " << out.bytes() << " bytes." << std::endl;
+	return 0;
+}
+
+// Main routine.
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--export") == 0)
+	{
+		if (argc != 5)
+		{
+			std::cerr << exportUsage << std::endl;
+			return 1;
+		}
+		return exportFractal(argv[2], argv[3], argv[4]);
+	}
+
+	printInteraction();
+	glutInit(&argc, argv);
+
+	// glutInitContextVersion(4, 3);
+	// glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
+
+	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGBA | GLUT_DEPTH);
+	glutInitWindowSize(500, 500);
+	glutInitWindowPosition(100, 100);
+	glutCreateWindow("Fractal Explorer");
+	glutDisplayFunc(drawScene);
+	glutReshapeFunc(resize);
+	glutKeyboardFunc(keyInput);
+
+	// Register the callback function for non-ASCII key entry.
+	glutSpecialFunc(specialKeyInput);
+
+	glewExperimental = GL_TRUE;
+	glewInit();
+
+	setup();
+
+	glutMainLoop();
+}
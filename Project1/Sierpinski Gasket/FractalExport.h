@@ -0,0 +1,353 @@
+///////////////////////////////////////////////////////////////
+// FractalExport.h
+//
+// Writes fractals to files for FractalExplorer.cpp's --export, as an
+// SVG path, a Wavefront OBJ mesh or raw binary floats. The vertices
+// are handed over one at a time in draw order, straight from the
+// generators in FractalEngine.h, and go out through a fixed size
+// buffer, so the memory used is the same for any depth; only the file
+// grows. Numbers in the text formats are written in the shortest form
+// that reads back as the same float.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef FRACTAL_EXPORT_H
+#define FRACTAL_EXPORT_H
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "FractalEngine.h"
+
+// Gathers small writes into a 1 MB buffer and writes it to the file when full.
+class BufferedWriter
+{
+public:
+	bool open(const char* path)
+	{
+		file = fopen(path, "wb");
+		buffer.resize(1 << 20);
+		used = 0;
+		written = 0;
+		failed = file == nullptr;
+		return !failed;
+	}
+
+	void write(const void* data, size_t bytes)
+	{
+		if (used + bytes > buffer.size())
+		{
+			flush();
+		}
+		if (bytes > buffer.size())
+		{
+			put(data, bytes);
+			return;
+		}
+		memcpy(buffer.data() + used, data, bytes);
+		used += bytes;
+	}
+
+	void text(const char* s)
+	{
+		write(s, strlen(s));
+	}
+
+	void character(char c)
+	{
+		if (used == buffer.size())
+		{
+			flush();
+		}
+		buffer[used++] = c;
+	}
+
+	void number(float value)
+	{
+		char digits[32];
+		std::to_chars_result end = std::to_chars(digits, digits + sizeof(digits), value);
+		write(digits, end.ptr - digits);
+	}
+
+	void number(size_t value)
+	{
+		char digits[32];
+		std::to_chars_result end = std::to_chars(digits, digits + sizeof(digits), value);
+		write(digits, end.ptr - digits);
+	}
+
+	// Writes what is left and closes the file, false if any write failed.
+	bool close()
+	{
+		if (file == nullptr)
+		{
+			return false;
+		}
+		flush();
+		failed |= fclose(file) != 0;
+		file = nullptr;
+		return !failed;
+	}
+
+	// Bytes written so far, buffered ones included.
+	size_t bytes() const
+	{
+		return written + used;
+	}
+
+private:
+	FILE* file = nullptr;
+	std::vector<char> buffer;
+	size_t used = 0, written = 0;
+	bool failed = false;
+
+	void flush()
+	{
+		put(buffer.data(), used);
+		used = 0;
+	}
+
+	void put(const void* data, size_t bytes)
+	{
+		if (file != nullptr && bytes > 0)
+		{
+			failed |= fwrite(data, 1, bytes, file) != bytes;
+			written += bytes;
+		}
+	}
+};
+
+// Streams one fractal to a file, vertex by vertex in the order it would be drawn.
+//   Svg     flat fractals only, y up in the square from -1 to 1 on a 500 by 500 page. Triangles are filled,
+//           lines stroked, one path for each run of vertices with the same color.
+//   Obj     v x y z r g b for every vertex, each face (f) or segment (l) right after its vertices.
+//   Binary  x y z of every vertex as little endian 32 bit floats, no header; three per triangle,
+//           two per segment or one per point of a line strip.
+class FractalExporter
+{
+public:
+	enum Format { Svg, Obj, Binary };
+	enum Shape { Triangles, Lines, LineStrip };
+
+	// The format a file name asks for by its extension, .svg, .obj or .bin; false for any other.
+	static bool formatOf(const char* path, Format& format)
+	{
+		const char* dot = strrchr(path, '.');
+		if (dot == nullptr)
+		{
+			return false;
+		}
+		if (strcmp(dot, ".svg") == 0)
+		{
+			format = Svg;
+		}
+		else if (strcmp(dot, ".obj") == 0)
+		{
+			format = Obj;
+		}
+		else if (strcmp(dot, ".bin") == 0)
+		{
+			format = Binary;
+		}
+		else
+		{
+			return false;
+		}
+		return true;
+	}
+
+	// About how many bytes a vertex takes in format, from the widest numbers written, to tell how big a file
+	// will get before writing it.
+	static double bytesPerVertex(Format format)
+	{
+		return format == Binary ? 12 : format == Svg ? 25 : 64;
+	}
+
+	bool open(const char* path, Format format, Shape shape, const char* name)
+	{
+		this->format = format;
+		this->shape = shape;
+		count = 0;
+		pathOpen = false;
+		if (!out.open(path))
+		{
+			return false;
+		}
+		if (format == Svg)
+		{
+			out.text("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+				"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"500\" height=\"500\" viewBox=\"-1 -1 2 2\">\n<title>");
+			out.text(name);
+			out.text("</title>\n<rect x=\"-1\" y=\"-1\" width=\"2\" height=\"2\" fill=\"white\"/>\n");
+		}
+		else if (format == Obj)
+		{
+			out.text("# ");
+			out.text(name);
+			out.character('\n');
+		}
+		return true;
+	}
+
+	void vertex(const FractalVertex& v)
+	{
+		count++;
+		if (format == Binary)
+		{
+			float position[3] = { v.x, v.y, v.z };
+			out.write(position, sizeof(position));
+		}
+		else if (format == Obj)
+		{
+			objVertex(v);
+		}
+		else
+		{
+			svgVertex(v);
+		}
+	}
+
+	// Finishes the file, false if anything could not be written.
+	bool close()
+	{
+		if (format == Svg)
+		{
+			if (pathOpen)
+			{
+				out.text("\"/>\n");
+			}
+			out.text("</svg>\n");
+		}
+		return out.close();
+	}
+
+	// Vertices and bytes written so far.
+	size_t vertices() const
+	{
+		return count;
+	}
+
+	size_t bytes() const
+	{
+		return out.bytes();
+	}
+
+private:
+	BufferedWriter out;
+	Format format = Binary;
+	Shape shape = Triangles;
+	size_t count = 0;
+	bool pathOpen = false; // an SVG path element is waiting for more points
+	char color[8] = ""; // of the open path
+	float lastX = 0, lastY = 0; // where the open path ends
+
+	void objVertex(const FractalVertex& v)
+	{
+		out.text("v ");
+		out.number(v.x);
+		out.character(' ');
+		out.number(v.y);
+		out.character(' ');
+		out.number(v.z);
+		out.character(' ');
+		out.number(v.r);
+		out.character(' ');
+		out.number(v.g);
+		out.character(' ');
+		out.number(v.b);
+		out.character('\n');
+
+		// OBJ counts vertices from 1, so the vertex just written is number count.
+		int corners = shape == Triangles ? 3 : 2;
+		bool complete = shape == LineStrip ? count >= 2 : count % corners == 0;
+		if (complete)
+		{
+			out.text(shape == Triangles ? "f" : "l");
+			for (size_t i = count - corners + 1; i <= count; i++)
+			{
+				out.character(' ');
+				out.number(i);
+			}
+			out.character('\n');
+		}
+	}
+
+	void svgVertex(const FractalVertex& v)
+	{
+		static const char digits[] = "0123456789abcdef";
+		int channels[3] = { channel(v.r), channel(v.g), channel(v.b) };
+		char hex[8] = { '#' };
+		for (int c = 0; c < 3; c++)
+		{
+			hex[1 + c * 2] = digits[channels[c] >> 4];
+			hex[2 + c * 2] = digits[channels[c] & 15];
+		}
+		float x = v.x, y = -v.y; // SVG's y points down
+		bool starts = shape == Triangles ? count % 3 == 1 : shape == Lines ? count % 2 == 1 : true;
+		bool moves = starts && shape != LineStrip; // triangles and segments each start with a move
+		if (shape == LineStrip && count == 1)
+		{
+			lastX = x; // every later point ends a segment, colored as that point is
+			lastY = y;
+			return;
+		}
+
+		if (starts && (!pathOpen || strcmp(hex, color) != 0))
+		{
+			// Each color gets its own path element; a strip changing color goes on from its last point.
+			bool carry = shape == LineStrip;
+			if (pathOpen)
+			{
+				out.text("\"/>\n");
+			}
+			out.text(shape == Triangles ? "<path stroke=\"none\" fill=\""
+				: "<path fill=\"none\" vector-effect=\"non-scaling-stroke\" stroke-width=\"1\" stroke=\"");
+			out.text(hex);
+			out.text("\" d=\"");
+			memcpy(color, hex, sizeof(hex));
+			pathOpen = true;
+			if (carry)
+			{
+				point('M', lastX, lastY);
+			}
+			else
+			{
+				moves = true;
+			}
+		}
+		else if (moves && shape == Lines && fabsf(x - lastX) < 1e-6f && fabsf(y - lastY) < 1e-6f)
+		{
+			// The segment starts where the last one ended, give or take the rounding of the maps leading
+			// to each, far below a pixel; the path is already there.
+			return;
+		}
+
+		point(moves ? 'M' : ' ', x, y);
+		if (shape == Triangles && count % 3 == 0)
+		{
+			out.character('Z');
+		}
+	}
+
+	// Writes a point of the path with the command before it; a space continues the current line.
+	void point(char command, float x, float y)
+	{
+		out.character(command);
+		out.number(x);
+		out.character(',');
+		out.number(y);
+		lastX = x;
+		lastY = y;
+	}
+
+	static int channel(float c)
+	{
+		return c <= 0 ? 0 : c >= 1 ? 255 : (int)(c * 255 + 0.5f);
+	}
+};
+
+#endif
@@ -7,9 +7,13 @@
 // Interaction:
 // Press the up arrow key to increase the number of fractals.
 // Press the down arrow key to decrease the number of fractals.
+// Click to choose the point the arrow keys zoom towards.
+// Press a to switch between view-dependent refinement and uniform depth.
 // Press r to reset.
 //
-// COMPILE: g++ -o KochSnowflake2D KochSnowflake2D.cpp -lGLEW -lGL -lGLU -lglut
+// Run with --benchmark to time building depths 8 to 14 from the level below on one thread and on every core.
+//
+// COMPILE: g++ -o KochSnowflake2D KochSnowflake2D.cpp -lGLEW -lGL -lGLU -lglut -pthread
 //
 // RUN: ./KochSnowflake2D
 //
@@ -18,51 +22,144 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "ParallelSubdivide.h"
+
 // Globals.
 static int fractals = 1; // initial fractal level
-static float zoom = 1.0f;  // Initial zoom level
+static double zoom = 1.0;  // Initial zoom level
+static double centerX = 0.0, centerY = 0.0; // Point of the snowflake at the middle of the window.
+static double focusX = 0.6, focusY = -0.35; // Point the zoom closes in on, a corner of the snowflake until the user clicks.
+static int windowWidth = 500, windowHeight = 500;
+static bool adaptive = true; // Refine only what is on screen and bigger than a pixel, instead of every segment.
+static const int maxFractals = 80; // 1.4^80 is about 5 * 10^11, doubles still resolve well below a pixel there.
+static const int maxUniformFractals = 11; // 3 * 4^11 points is 100 MB, 133 MB with every level below it kept.
+static const float root3 = sqrt(3.0f); // Worked out once for every segment of every level.
+static const double pixelThreshold = 1.0; // Segments shorter than this on screen are drawn as they are.
+static const size_t maxAdaptiveSegments = 1 << 20; // Safety limit on the refined outline, it normally stays near ten thousand.
+static std::vector<float> adaptiveLines; // The refined outline as pairs of window coordinates.
+static std::vector<std::vector<float>> levels; // levels[n] holds the start point of every segment of the outline at depth n.
+
+// Divides the segment from (x1, y1) to (x2, y2) into the four pieces of the next level, putting the start
+// points of the last three pieces in starts; the first piece starts at (x1, y1).
+inline void divideKochPiece(float x1, float y1, float x2, float y2, float starts[3][2])
+{
+	// Step 1: Divide the line segment into three equal parts
+	float dx = x2 - x1;
+	float dy = y2 - y1;
+
+	// Coordinates of the first division point (one-third of the way along the segment)
+	float x3 = x1 + dx / 3;
+	float y3 = y1 + dy / 3;
+
+	// Coordinates of the second division point (two-thirds of the way along the segment)
+	float x4 = x1 + 2 * dx / 3;
+	float y4 = y1 + 2 * dy / 3;
+
+	// Step 2: Calculate the peak of the equilateral triangle that should replace the middle third
+	// The new vertex is at the midpoint of x3 and x4, shifted along the perpendicular bisector
+	starts[0][0] = x3;
+	starts[0][1] = y3;
+	starts[1][0] = (x3 + x4 + root3 * (y3 - y4)) / 2;
+	starts[1][1] = (y3 + y4 + root3 * (x4 - x3)) / 2;
+	starts[2][0] = x4;
+	starts[2][1] = y4;
+}
+
+// Fills next with the level after the closed outline whose count segments start at the points of previous,
+// in one pass: segment i becomes the four segments starting at 4 * i. Each task takes a run of segments and
+// writes only its own slice of next, using threads threads.
+void nextKochLevel(const float* previous, size_t count, float* next, unsigned threads = subdivisionThreads())
+{
+	const size_t run = 1 << 14;
+	parallelTasks((count + run - 1) / run, threads, [&](size_t task)
+	{
+		size_t end = std::min(count, (task + 1) * run);
+		for (size_t i = task * run; i < end; i++)
+		{
+			size_t j = i + 1 == count ? 0 : i + 1; // the last segment closes the outline
+			float starts[3][2];
+			divideKochPiece(previous[i * 2], previous[i * 2 + 1], previous[j * 2], previous[j * 2 + 1], starts);
+			float* out = next + i * 8;
+			out[0] = previous[i * 2];
+			out[1] = previous[i * 2 + 1];
+			for (int k = 0; k < 3; k++)
+			{
+				out[2 + k * 2] = starts[k][0];
+				out[3 + k * 2] = starts[k][1];
+			}
+		}
+	});
+}
 
-void drawKochSegment(float x1, float y1, float x2, float y2, int depth)
+// Returns the outline at depth n. Levels not built yet are derived one from the other, each from the level
+// below it, and every level is kept: stepping up costs only the new segments and stepping down costs nothing.
+const std::vector<float>& kochLevel(int n)
 {
-	// Base Case: depth = 0, If the depth of recursion reaches 0, simply draw a straight line segment from (x1, y1) to (x2, y2).
-	if (depth == 0)
+	if (levels.empty())
 	{
-		glVertex3f(x1, y1, 0.0); // first endpoint of line
-		glVertex3f(x2, y2, 0.0); // second endpoint of line
+		// Initial triangle
+		levels.reserve(maxUniformFractals + 1);
+		levels.push_back({ -0.6f, -0.35f, 0.6f, -0.35f, 0.0f, 0.65f });
 	}
-	else
+	while ((int)levels.size() <= n)
 	{
-		// Step 1: Divide the line segment into three equal parts
-		float dx = x2 - x1;
-		float dy = y2 - y1;
-		
-		// Coordinates of the first division point (one-third of the way along the segment)
-		float x3 = x1 + dx / 3;
-		float y3 = y1 + dy / 3;
-
-		// Coordinates of the second division point (two-thirds of the way along the segment)
-		float x4 = x1 + 2 * dx / 3;
-		float y4 = y1 + 2 * dy / 3;
-
-		// Step 2: Calculate the peak of the equilateral triangle that should replace the middle third
-		// The new vertex is at the midpoint of x3 and x4, shifted along the perpendicular bisector
-		float mx = (x3 + x4 + sqrt(3) * (y3 - y4)) / 2;
-		float my = (y3 + y4 + sqrt(3) * (x4 - x3)) / 2;
-
-		// Step 3: Recursively apply the process to each of the four new line segments
-		// Recurse for the segment from the start to the first division point
-		drawKochSegment(x1, y1, x3, y3, depth - 1);
-		// Recurse for the segment from the first division point to the new vertex (forming one side of the new triangle)
-		drawKochSegment(x3, y3, mx, my, depth - 1);
-		// Recurse for the segment from the new vertex to the second division point (forming the second side of the new triangle)
-		drawKochSegment(mx, my, x4, y4, depth - 1);
-		// Recurse for the segment from the second division point to the end of the original segment
-		drawKochSegment(x4, y4, x2, y2, depth - 1);
+		const std::vector<float>& previous = levels.back();
+		std::vector<float> next(previous.size() * 4); // exactly four times the segments, allocated once
+		nextKochLevel(previous.data(), previous.size() / 2, next.data());
+		levels.push_back(std::move(next));
 	}
+	return levels[n];
+}
+
+// Appends the Koch curve from (x1, y1) to (x2, y2) to adaptiveLines as pairs of window coordinates,
+// subdividing only the parts that can be seen. A segment is drawn whole at depth 0, once it is shorter than
+// pixelThreshold on screen, or if the safety limit is reached; a segment whose whole curve lies off screen
+// is dropped. Everything is worked out in double and made relative to the window center before it is
+// turned into floats, so deep zooms keep their precision.
+void refineKochSegment(double x1, double y1, double x2, double y2, int depth)
+{
+	double dx = x2 - x1;
+	double dy = y2 - y1;
+
+	// The curve over a segment stays inside the triangle under its peak, so within half the segment's length of its midpoint.
+	double midX = ((x1 + x2) / 2 - centerX) * zoom;
+	double midY = ((y1 + y2) / 2 - centerY) * zoom;
+	double radius = sqrt(dx * dx + dy * dy) / 2 * zoom;
+	if (fabs(midX) - radius > 1.0 || fabs(midY) - radius > 1.0)
+	{
+		return;
+	}
+
+	double pixelsX = dx * zoom * windowWidth / 2;
+	double pixelsY = dy * zoom * windowHeight / 2;
+	if (depth == 0 || pixelsX * pixelsX + pixelsY * pixelsY < pixelThreshold * pixelThreshold
+		|| adaptiveLines.size() >= maxAdaptiveSegments * 4)
+	{
+		float line[4] = { (float)((x1 - centerX) * zoom), (float)((y1 - centerY) * zoom), (float)((x2 - centerX) * zoom), (float)((y2 - centerY) * zoom) };
+		adaptiveLines.insert(adaptiveLines.end(), line, line + 4);
+		return;
+	}
+
+	// Same division as divideKochPiece: thirds, then the peak over the middle third.
+	const double root3 = sqrt(3.0);
+	double x3 = x1 + dx / 3;
+	double y3 = y1 + dy / 3;
+	double x4 = x1 + 2 * dx / 3;
+	double y4 = y1 + 2 * dy / 3;
+	double mx = (x3 + x4 + root3 * (y3 - y4)) / 2;
+	double my = (y3 + y4 + root3 * (x4 - x3)) / 2;
+
+	refineKochSegment(x1, y1, x3, y3, depth - 1);
+	refineKochSegment(x3, y3, mx, my, depth - 1);
+	refineKochSegment(mx, my, x4, y4, depth - 1);
+	refineKochSegment(x4, y4, x2, y2, depth - 1);
 }
 
 // Drawing routine.
@@ -70,22 +167,37 @@ void drawScene(void)
 {
 	glClear(GL_COLOR_BUFFER_BIT);
 	glLoadIdentity();
-	glScalef(zoom, zoom, 1.0f);
 
-	glBegin(GL_LINES);
-	glColor3f(1.0, 0.0, 0.0);
+	if (adaptive)
+	{
+		// Rebuilt every frame from the three sides, the work depends on the window and not on the zoom.
+		adaptiveLines.clear();
+		refineKochSegment(-0.6, -0.35, 0.6, -0.35, fractals);
+		refineKochSegment(0.6, -0.35, 0.0, 0.65, fractals);
+		refineKochSegment(0.0, 0.65, -0.6, -0.35, fractals);
+
+		glColor3f(1.0, 0.0, 0.0);
+		glEnableClientState(GL_VERTEX_ARRAY);
+		glVertexPointer(2, GL_FLOAT, 0, adaptiveLines.data());
+		glDrawArrays(GL_LINES, 0, (GLsizei)(adaptiveLines.size() / 2));
+		glDisableClientState(GL_VERTEX_ARRAY);
 
-	// Initial triangle
-	float x1 = -0.6, y1 = -0.35;
-	float x2 = 0.6, y2 = -0.35;
-	float x3 = 0.0, y3 = 0.65;
+		glutSwapBuffers();
+		return;
+	}
+
+	glScaled(zoom, zoom, 1.0);
+	glTranslated(-centerX, -centerY, 0.0);
 
-	// draw the segments, with fractals being the depth
-	drawKochSegment(x1, y1, x2, y2, fractals);
-	drawKochSegment(x2, y2, x3, y3, fractals);
-	drawKochSegment(x3, y3, x1, y1, fractals);
+	// the outline at depth fractals, built from the level below it the first time it is shown
+	const std::vector<float>& snowflake = kochLevel(fractals);
 
-	glEnd();
+	// every segment ends where the next starts, so the outline is one loop through the start points
+	glColor3f(1.0, 0.0, 0.0);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, snowflake.data());
+	glDrawArrays(GL_LINE_LOOP, 0, (GLsizei)(snowflake.size() / 2));
+	glDisableClientState(GL_VERTEX_ARRAY);
 
 	glutSwapBuffers();
 }
@@ -100,6 +212,8 @@ void setup(void)
 void resize(int w, int h)
 {
 	glViewport(0, 0, w, h);
+	windowWidth = w;
+	windowHeight = h;
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	glOrtho(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
@@ -115,6 +229,18 @@ void keyInput(unsigned char key, int x, int y)
 	case 'r': // reset to original number of fractals.
 		fractals = 1;
 		zoom = 1;
+		centerX = centerY = 0.0;
+		focusX = 0.6;
+		focusY = -0.35;
+		glutPostRedisplay();
+		break;
+	case 'a': // switch between view-dependent refinement and uniform depth.
+		adaptive = !adaptive;
+		if (!adaptive && fractals > maxUniformFractals)
+		{
+			fractals = maxUniformFractals; // deeper levels are only drawn refined
+		}
+		std::cout << (adaptive ? "View-dependent refinement." : "Uniform depth.") << std::endl;
 		glutPostRedisplay();
 		break;
 	case 27: // escape will leave the program
@@ -125,13 +251,39 @@ void keyInput(unsigned char key, int x, int y)
 	}
 }
 
+// Zooms by factor keeping the focus point where it is on screen.
+void zoomTowardsFocus(double factor)
+{
+	centerX = focusX - (focusX - centerX) / factor;
+	centerY = focusY - (focusY - centerY) / factor;
+	zoom *= factor;
+}
+
+// Mouse callback routine, a left click makes the point under the cursor the one zoomed towards.
+void mouseInput(int button, int state, int x, int y)
+{
+	if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN)
+	{
+		focusX = centerX + (2.0 * x / windowWidth - 1.0) / zoom;
+		focusY = centerY + (1.0 - 2.0 * y / windowHeight) / zoom;
+	}
+}
+
 // Callback routine for non-ASCII key entry.
 void specialKeyInput(int key, int x, int y)
 {
 	if (key == GLUT_KEY_UP)
 	{
-		zoom *= 1.4;
-		fractals += 1; // increase number of fractals by 1
+		int deepest = adaptive ? maxFractals : maxUniformFractals;
+		if (fractals == deepest)
+		{
+			std::cout << "Deepest level is " << deepest << (adaptive ? "." : ", press a to go deeper refined.") << std::endl; // each uniform level quadruples the memory used
+		}
+		else
+		{
+			zoomTowardsFocus(1.4);
+			fractals += 1; // increase number of fractals by 1
+		}
 	}
 	if (key == GLUT_KEY_DOWN)
 	{
@@ -141,7 +293,7 @@ void specialKeyInput(int key, int x, int y)
 		}
 		else
 		{
-			zoom /= 1.4;
+			zoomTowardsFocus(1 / 1.4);
 			fractals -= 1; // decrease number of fractals by 1
 		}
 	}
@@ -154,12 +306,33 @@ void printInteraction(void)
 	std::cout << "Interaction:" << std::endl;
 	std::cout << "Press the up arrow key to increase number of fractals." << std::endl
 		<< "Press the down arrow key to decrease number of fractals." << std::endl
+		<< "Click to choose the point the arrow keys zoom towards." << std::endl
+		<< "Press a to switch between view-dependent refinement and uniform depth." << std::endl
 		<< "Press r to reset." << std::endl;
 }
 
+// Times building each level of the snowflake from the cached level below it, the way kochLevel does, on one
+// thread and on every core, no window needed. The levels below are built first so only the new level is timed;
+// leaves counts the segments of one side, each side taking two floats per segment.
+void runBenchmark(void)
+{
+	kochLevel(12); // depth 13 is the deepest to fit in the memory benchmarkSubdivision allows
+	benchmarkSubdivision("Koch snowflake", 4, 6, [](int m, float* out, unsigned threads)
+	{
+		const std::vector<float>& previous = kochLevel(m - 1);
+		nextKochLevel(previous.data(), previous.size() / 2, out, threads);
+	});
+}
+
 // Main routine.
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		runBenchmark();
+		return 0;
+	}
+
 	printInteraction();
 	glutInit(&argc, argv);
 
@@ -177,6 +350,9 @@ int main(int argc, char** argv)
 	// Register the callback function for non-ASCII key entry.
 	glutSpecialFunc(specialKeyInput);
 
+	// Register the mouse callback function.
+	glutMouseFunc(mouseInput);
+
 	glewExperimental = GL_TRUE;
 	glewInit();
 
@@ -0,0 +1,111 @@
+///////////////////////////////////////////////////////////////
+// ParallelSubdivide.h
+//
+// Shared by the gasket and snowflake programs to generate deep levels
+// on every core. The number of leaves under any piece of a subdivision
+// is known up front, so the top levels are expanded first and every
+// subtree below them is then finished by a task that writes only into
+// its own slice of the output buffer. There are no locks and nothing
+// to merge, and the result is the same as generating on one thread.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef PARALLEL_SUBDIVIDE_H
+#define PARALLEL_SUBDIVIDE_H
+
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Number of threads to generate on, one per core.
+inline unsigned subdivisionThreads()
+{
+	unsigned threads = std::thread::hardware_concurrency();
+	return threads == 0 ? 1 : threads;
+}
+
+// Leaves under each subtree handed to a task: the first level with at least four subtrees per thread,
+// so threads that finish early pick up the rest. Small subdivisions stay in one piece, starting
+// threads would cost more than they save.
+inline size_t splitStride(size_t leaves, size_t branching, unsigned threads)
+{
+	if (threads <= 1 || leaves < (1 << 14))
+	{
+		return leaves;
+	}
+	size_t stride = leaves;
+	while (stride > 1 && leaves / stride < 4 * (size_t)threads)
+	{
+		stride /= branching;
+	}
+	return stride;
+}
+
+// Runs task(i) for every i below tasks on up to threads threads, each taking the next index when it finishes one.
+template <class Task>
+void parallelTasks(size_t tasks, unsigned threads, Task task)
+{
+	std::atomic<size_t> next(0);
+	auto worker = [&]()
+	{
+		for (size_t i = next++; i < tasks; i = next++)
+		{
+			task(i);
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads && t < tasks; t++)
+	{
+		pool.emplace_back(worker);
+	}
+	worker(); // the calling thread works too
+	for (std::thread& thread : pool)
+	{
+		thread.join();
+	}
+}
+
+// Times generate(m, out, threads) on one thread and on every core for depths 8 to 14, for --benchmark.
+// Depths whose output would not fit in 2.5 GB are listed but skipped.
+template <class Generate>
+void benchmarkSubdivision(const char* name, size_t branching, size_t floatsPerLeaf, Generate generate)
+{
+	const size_t budget = (size_t)2560 << 20;
+	unsigned threads = subdivisionThreads();
+	std::cout << name << " on " << threads << (threads == 1 ? " thread:" : " threads:") << std::endl;
+	std::cout << "depth       leaves   1 thread ms   " << std::setw(2) << threads << " threads ms   speedup" << std::endl;
+
+	size_t leaves = 1;
+	for (int m = 0; m < 8; m++)
+	{
+		leaves *= branching;
+	}
+	for (int m = 8; m <= 14; m++, leaves *= branching)
+	{
+		std::cout << std::setw(5) << m << std::setw(13) << leaves;
+		size_t bytes = leaves * floatsPerLeaf * sizeof(float);
+		if (bytes > budget)
+		{
+			std::cout << "   skipped, needs " << (bytes >> 20) << " MB" << std::endl;
+			continue;
+		}
+		std::vector<float> buffer(leaves * floatsPerLeaf); // touched once here so page faults are not timed
+
+		double times[2];
+		unsigned counts[2] = { 1, threads };
+		for (int run = 0; run < 2; run++)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			generate(m, buffer.data(), counts[run]);
+			times[run] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::cout << std::fixed << std::setprecision(1) << std::setw(14) << times[0] << std::setw(16) << times[1]
+			<< std::setprecision(2) << std::setw(10) << times[0] / times[1] << std::endl;
+	}
+}
+
+#endif
@@ -7,69 +7,280 @@
 // Interaction:
 // Press the up arrow key to increase the number of fractals.
 // Press the down arrow key to decrease the number of fractals.
+// Press i to switch between the cached geometry and instanced drawing.
+// Press c to switch between subdivision and the chaos game.
 // Press r to reset.
 //
-// COMPILE: g++ -o SierpinskiTriangle2D SierpinskiTriangle2D.cpp -lGLEW -lGL -lGLU -lglut
+// Run with --benchmark to time generating depths 8 to 14 on one thread and on every core.
+//
+// COMPILE: g++ -o SierpinskiTriangle2D SierpinskiTriangle2D.cpp -lGLEW -lGL -lGLU -lglut -pthread
 // RUN: ./SierpinskiTriangle2D
 //
 // Jonathon Moore.
 ///////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <cstring>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "ChaosGame.h"
+#include "ParallelSubdivide.h"
+
 // Globals.
 static int fractals = 1;
+static const int maxFractals = 13; // 3^13 triangles is about 38 MB of vertices.
+static GLuint depthVBO[maxFractals + 1]; // Gasket geometry for every depth built so far, 0 if not built yet.
+static bool instanced = false; // Draw one triangle 3^m times with the maps applied in a shader instead.
+static GLuint instanceProgram = 0; // Shader for the instanced mode.
+static GLuint baseVBO = 0; // The one triangle the instanced mode draws.
+static bool chaos = false; // Draw the gasket by the chaos game into a density texture instead, detail grows with time not memory.
+static ChaosGame chaosGame;
+static const size_t chaosStepsPerFrame = 1 << 17; // Jumps of each thread's eight points between frames.
+static const uint64_t chaosPointLimit = (uint64_t)1 << 33; // Stop after about 8.6 billion points, tens of thousands per pixel.
+static int windowWidth = 500, windowHeight = 500;
+
+// The three maps of the gasket each halve the plane towards one corner: digit k of the instance number
+// picks map p -> (p + corners[k]) / 2. Applying one map per base 3 digit lands the base triangle on
+// the leaf that instance stands for, so no per instance data is stored at all.
+static const char* instanceVertexShader =
+	"#version 330 compatibility\n"
+	"uniform vec2 corners[3];\n"
+	"uniform int depth;\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 p = gl_Vertex.xy;\n"
+	"	int digits = gl_InstanceID;\n"
+	"	for (int level = 0; level < depth; level++)\n"
+	"	{\n"
+	"		p = (p + corners[digits % 3]) * 0.5;\n"
+	"		digits /= 3;\n"
+	"	}\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 0.0, 1.0);\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"}\n";
 
-// Draws a triangle on screen with the three given vertices.
-void drawTriangle(float* a, float* b, float* c)
+static const char* instanceFragmentShader =
+	"#version 330 compatibility\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
+
+// Expands the triangles of out in slots first up to first + leaves, each standing for stride leaves,
+// until each stands for until leaves. Works level by level instead of recursing: at each level every triangle
+// is replaced in place by its three children, spread out to the slots its subtree will end up in, so the
+// buffer is never resized or copied and only the slots given are touched.
+void expandTriangles(float* out, size_t first, size_t leaves, size_t stride, size_t until)
 {
-	glBegin(GL_TRIANGLES);
-	glColor3f(0, 0, 0);
-	glVertex2fv(a);
-	glVertex2fv(b);
-	glVertex2fv(c);
-	glEnd();
+	// stride is the number of leaves under each triangle of the current level.
+	for (; stride > until; stride /= 3)
+	{
+		size_t child = stride / 3;
+		for (size_t slot = first; slot < first + leaves; slot += stride)
+		{
+			float* t = out + slot * 6;
+			float pa[2] = { t[0], t[1] }, pb[2] = { t[2], t[3] }, pc[2] = { t[4], t[5] };
+			float v0[2], v1[2], v2[2];
+
+			// Calculate midpoints between vertices a-b, a-c, and b-c.
+			for (int i = 0; i < 2; i++)
+			{
+				v0[i] = (pa[i] + pb[i]) / 2; // v0 is the midpoint between a and b
+				v1[i] = (pa[i] + pc[i]) / 2; // v1 is the midpoint between a and c
+				v2[i] = (pb[i] + pc[i]) / 2; // v2 is the midpoint between b and c
+			}
+
+			// Triangles a, v0, v1 then c, v1, v2 then b, v2, v0, the first one reuses the parent's slot.
+			float children[3][6] =
+			{
+				{ pa[0], pa[1], v0[0], v0[1], v1[0], v1[1] },
+				{ pc[0], pc[1], v1[0], v1[1], v2[0], v2[1] },
+				{ pb[0], pb[1], v2[0], v2[1], v0[0], v0[1] }
+			};
+			for (int k = 0; k < 3; k++)
+			{
+				float* dst = out + (slot + k * child) * 6;
+				for (int i = 0; i < 6; i++)
+				{
+					dst[i] = children[k][i];
+				}
+			}
+		}
+	}
 }
 
-void divideTriangle(float* a, float* b, float* c, int m)
+// Fills out with the 3^m triangles of the gasket inside a, b, c, six floats per triangle, using threads threads.
+// The top levels are expanded here, then every subtree below them is finished by its own task in its own
+// slice of out. The triangles come out in the same order the recursive version drew them.
+void divideTriangle(float* a, float* b, float* c, int m, float* out, unsigned threads = subdivisionThreads())
 {
-	// Base case: if m is zero, draw the triangle using the vertices a, b, and c.
-	if (m > 0)
+	// Start with the whole triangle in slot 0.
+	size_t count = 1;
+	for (int level = 0; level < m; level++)
 	{
-		// Initialize midpoint vertices for the next level of triangles.
-		float v0[2], v1[2], v2[2];
+		count *= 3;
+	}
+	float start[6] = { a[0], a[1], b[0], b[1], c[0], c[1] };
+	for (int i = 0; i < 6; i++)
+	{
+		out[i] = start[i];
+	}
+
+	size_t split = splitStride(count, 3, threads);
+	expandTriangles(out, 0, count, count, split);
+	parallelTasks(count / split, threads, [&](size_t task)
+	{
+		expandTriangles(out, task * split, split, split, 1);
+	});
+}
 
-		// Calculate midpoints between vertices a-b, a-c, and b-c.
-		for (int i = 0; i < 2; i++)
+// Returns the VBO holding the gasket at depth m, generating and uploading it the first time that depth is shown.
+GLuint gasketBuffer(int m)
+{
+	if (depthVBO[m] == 0)
+	{
+		float vertices[3][2] = { {-1.0, -1.0}, {0.0, 1.0}, {1.0, -1.0} }; // set initial vertices to bottom left, top middle, and bottom left
+
+		size_t triangles = 1;
+		for (int level = 0; level < m; level++)
 		{
-			v0[i] = (a[i] + b[i]) / 2; // v0 is the midpoint between a and b
-			v1[i] = (a[i] + c[i]) / 2; // v1 is the midpoint between a and c
-			v2[i] = (b[i] + c[i]) / 2; // v2 is the midpoint between b and c
+			triangles *= 3;
 		}
-		// Recursively divide the triangle formed by vertices a, v0, and v1
-		divideTriangle(a, v0, v1, m - 1);
-		// Recursively divide the triangle formed by vertices c, v1, and v2
-		divideTriangle(c, v1, v2, m - 1);
-		// Recursively divide the triangle formed by vertices b, v2, and v0
-		divideTriangle(b, v2, v0, m - 1);
+		std::vector<float> buffer(triangles * 6); // exactly 3^m triangles, allocated once
+		divideTriangle(vertices[0], vertices[1], vertices[2], m, buffer.data());
+
+		glGenBuffers(1, &depthVBO[m]);
+		glBindBuffer(GL_ARRAY_BUFFER, depthVBO[m]);
+		glBufferData(GL_ARRAY_BUFFER, buffer.size() * sizeof(float), buffer.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
-	else
+	return depthVBO[m];
+}
+
+// Compiles and links a vertex and fragment shader, printing the log if either fails.
+GLuint buildProgram(const char* vertexSource, const char* fragmentSource)
+{
+	GLuint program = glCreateProgram();
+	const char* sources[2] = { vertexSource, fragmentSource };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int i = 0; i < 2; i++)
+	{
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char log[1024];
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cout << "Shader compilation failed:" << std::endl << log << std::endl;
+		}
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
+	}
+	glLinkProgram(program);
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "Shader linking failed:" << std::endl << log << std::endl;
+	}
+	return program;
+}
+
+// Draws the gasket at depth m as 3^m instances of one triangle, memory used does not grow with depth.
+void drawInstanced(int m)
+{
+	float vertices[3][2] = { {-1.0, -1.0}, {0.0, 1.0}, {1.0, -1.0} }; // set initial vertices to bottom left, top middle, and bottom left
+	if (instanceProgram == 0)
+	{
+		instanceProgram = buildProgram(instanceVertexShader, instanceFragmentShader);
+		glGenBuffers(1, &baseVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, baseVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Same child order as divideTriangle: towards a, then c, then b.
+	float corners[3][2] = { { vertices[0][0], vertices[0][1] }, { vertices[2][0], vertices[2][1] }, { vertices[1][0], vertices[1][1] } };
+	GLsizei instances = 1;
+	for (int level = 0; level < m; level++)
 	{
-		// Draw the triangle using vertices a, b, and c when no further subdivision is needed
-		drawTriangle(a, b, c);
+		instances *= 3;
 	}
+
+	glUseProgram(instanceProgram);
+	glUniform2fv(glGetUniformLocation(instanceProgram, "corners"), 3, &corners[0][0]);
+	glUniform1i(glGetUniformLocation(instanceProgram, "depth"), m);
+	glBindBuffer(GL_ARRAY_BUFFER, baseVBO);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, (void*)0);
+	glColor3f(0, 0, 0);
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 3, instances);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
+}
+
+// Idle routine while the chaos game runs: add points on every thread and refresh the texture.
+void chaosIdle(void)
+{
+	chaosGame.run(chaosStepsPerFrame);
+	chaosGame.resolve();
+	if (chaosGame.points() >= chaosPointLimit)
+	{
+		glutIdleFunc(NULL);
+		std::cout << "Chaos game finished after " << chaosGame.points() / 1000000 << " million points." << std::endl;
+	}
+	glutPostRedisplay();
+}
+
+// Starts the chaos game over with a histogram the size of the window.
+void startChaosGame(void)
+{
+	float corners[3][2] = { {-1.0, -1.0}, {0.0, 1.0}, {1.0, -1.0} }; // same corners as the subdivided gasket
+	chaosGame.create(windowWidth, windowHeight, subdivisionThreads(), corners, 3);
+	glutIdleFunc(chaosIdle);
 }
 
 // Drawing routine.
 void drawScene(void)
 {
-	float vertices[3][2] = { {-1.0, -1.0}, {0.0, 1.0}, {1.0, -1.0} }; // set initial vertices to bottom left, top middle, and bottom left
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	divideTriangle(vertices[0], vertices[1], vertices[2], fractals);  // first call to initiate recursive calls where n = fractals
+	if (chaos)
+	{
+		chaosGame.draw();
+		glutSwapBuffers();
+		return;
+	}
+
+	if (instanced)
+	{
+		drawInstanced(fractals);
+		glutSwapBuffers();
+		return;
+	}
+
+	// The whole gasket is one draw call from its cached buffer.
+	GLsizei vertexCount = 3;
+	for (int level = 0; level < fractals; level++)
+	{
+		vertexCount *= 3;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, gasketBuffer(fractals));
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glVertexPointer(2, GL_FLOAT, 0, (void*)0);
+	glColor3f(0, 0, 0);
+	glDrawArrays(GL_TRIANGLES, 0, vertexCount);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
 	glutSwapBuffers();
 }
@@ -84,6 +295,12 @@ void setup(void)
 void resize(int w, int h)
 {
 	glViewport(0, 0, w, h);
+	windowWidth = w;
+	windowHeight = h;
+	if (chaos)
+	{
+		startChaosGame(); // the histogram has one counter per pixel
+	}
 	glMatrixMode(GL_PROJECTION);
 	glLoadIdentity();
 	glOrtho(-1.0, 1.0, -1.0, 1.0, -1.0, 1.0);
@@ -100,6 +317,25 @@ void keyInput(unsigned char key, int x, int y)
 		fractals = 1;
 		glutPostRedisplay();
 		break;
+	case 'i': // switch between cached geometry and instancing.
+		instanced = !instanced;
+		std::cout << (instanced ? "Instanced drawing." : "Cached geometry.") << std::endl;
+		glutPostRedisplay();
+		break;
+	case 'c': // switch between subdivision and the chaos game.
+		chaos = !chaos;
+		if (chaos)
+		{
+			startChaosGame();
+		}
+		else
+		{
+			glutIdleFunc(NULL);
+			chaosGame.destroy();
+		}
+		std::cout << (chaos ? "Chaos game." : "Subdivision.") << std::endl;
+		glutPostRedisplay();
+		break;
 	case 27: // escape will leave the program
 		exit(0);
 		break;
@@ -113,7 +349,14 @@ void specialKeyInput(int key, int x, int y)
 {
 	if (key == GLUT_KEY_UP)
 	{
-		fractals += 1; // increase number of fractals by 1
+		if (fractals == maxFractals)
+		{
+			std::cout << "Deepest level is " << maxFractals << "." << std::endl; // each level triples the memory used
+		}
+		else
+		{
+			fractals += 1; // increase number of fractals by 1
+		}
 	}
 	if (key == GLUT_KEY_DOWN)
 	{
@@ -135,12 +378,30 @@ void printInteraction(void)
 	std::cout << "Interaction:" << std::endl;
 	std::cout << "Press the up arrow key to increase number of fractals." << std::endl
 		<< "Press the down arrow key to decrease number of fractals." << std::endl
+		<< "Press i to switch between cached geometry and instanced drawing." << std::endl
+		<< "Press c to switch between subdivision and the chaos game." << std::endl
 		<< "Press r to reset." << std::endl;
 }
 
+// Times generating the gasket on one thread and on every core, no window needed.
+void runBenchmark(void)
+{
+	float vertices[3][2] = { {-1.0, -1.0}, {0.0, 1.0}, {1.0, -1.0} };
+	benchmarkSubdivision("Sierpinski triangle", 3, 6, [&](int m, float* out, unsigned threads)
+	{
+		divideTriangle(vertices[0], vertices[1], vertices[2], m, out, threads);
+	});
+}
+
 // Main routine.
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		runBenchmark();
+		return 0;
+	}
+
 	printInteraction();
 	glutInit(&argc, argv);
 
@@ -8,9 +8,12 @@
 // Press the up arrow key to increase the number of fractals.
 // Press the down arrow key to decrease the number of fractals.
 // Press space bar to rotate object.
+// Press i to switch between the welded mesh and instanced drawing.
 // Press r to reset.
 //
-// COMPILE: g++ -o SierpinskiTriangle3D SierpinskiTriangle3D.cpp -lGLEW -lGL -lGLU -lglut
+// Run with --benchmark to time generating depths 8 to 14 on one thread and on every core.
+//
+// COMPILE: g++ -o SierpinskiTriangle3D SierpinskiTriangle3D.cpp -lGLEW -lGL -lGLU -lglut -pthread
 //
 // RUN: ./SierpinskiTriangle3D
 //
@@ -18,78 +21,326 @@
 ///////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
 
+#include "ParallelSubdivide.h"
+
 // Globals.
 static int fractals = 1; // Holds value for number of fractals.
+static const int maxFractals = 12; // 4^12 is about 16 million tetrahedra, deeper ones are smaller than a pixel.
 static float Angle = 0.0; // Angle to rotate the sphere.
+static bool instanced = false; // Draw one tetrahedron 4^m times with the maps applied in a shader instead.
+static const int maxMeshFractals = 8; // Welding 4^m tetrahedra on a key press stays well under a second up to here.
+static GLuint instanceProgram = 0; // Shader for the instanced mode.
+static GLuint baseVBO = 0; // The one tetrahedron the instanced mode draws, position and color per vertex.
+
+// The four maps of the gasket each halve space towards one corner: digit k of the instance number
+// picks map p -> (p + corners[k]) / 2. Applying one map per base 4 digit lands the base tetrahedron on
+// the leaf that instance stands for, so no per instance data is stored at all.
+static const char* instanceVertexShader =
+	"#version 330 compatibility\n"
+	"uniform vec3 corners[4];\n"
+	"uniform int depth;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 p = gl_Vertex.xyz;\n"
+	"	int digits = gl_InstanceID;\n"
+	"	for (int level = 0; level < depth; level++)\n"
+	"	{\n"
+	"		p = (p + corners[digits & 3]) * 0.5;\n"
+	"		digits >>= 2;\n"
+	"	}\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * vec4(p, 1.0);\n"
+	"	gl_FrontColor = gl_Color;\n"
+	"}\n";
 
-// Function to draw a tetrahedron given four vertices
-void drawTetrahedron(float* a, float* b, float* c, float* d)
+static const char* instanceFragmentShader =
+	"#version 330 compatibility\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = gl_Color;\n"
+	"}\n";
+
+// Welded, indexed mesh of the gasket at one depth, built the first time that depth is shown.
+struct GasketMesh
 {
-	glEnable(GL_DEPTH_TEST); // Make sure to enable the depth test otherwise it will not display correctly.
-	glBegin(GL_TRIANGLES);
-	glColor3f(1.0, 0.0, 0.0);
-	glVertex3fv(a);
-	glVertex3fv(b);
-	glVertex3fv(c);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	glColor3f(1.0, 1.0, 0.0);
-	glVertex3fv(a);
-	glVertex3fv(b);
-	glVertex3fv(d);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	glColor3f(1.0, 0.0, 1.0);
-	glVertex3fv(a);
-	glVertex3fv(c);
-	glVertex3fv(d);
-	glEnd();
-
-	glBegin(GL_TRIANGLES);
-	glColor3f(0.0, 0.0, 1.0);
-	glVertex3fv(b);
-	glVertex3fv(c);
-	glVertex3fv(d);
-	glEnd();
-	glDisable(GL_DEPTH_TEST);
+	GLuint vbo = 0, ibo = 0;
+	GLsizei indexCount = 0;
+};
+static GasketMesh meshes[maxMeshFractals + 1];
+
+// A position snapped to a fine grid, plus the face color, identifies a welded vertex.
+struct WeldKey
+{
+	int64_t x, y, z;
+	int color;
+	bool operator==(const WeldKey& o) const { return x == o.x && y == o.y && z == o.z && color == o.color; }
+};
+
+struct WeldKeyHash
+{
+	size_t operator()(const WeldKey& k) const
+	{
+		uint64_t h = (uint64_t)k.x * 0x9E3779B97F4A7C15ull;
+		h ^= (uint64_t)k.y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+		h ^= (uint64_t)k.z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+		h ^= (uint64_t)k.color + (h << 6) + (h >> 2);
+		return (size_t)h;
+	}
+};
+
+// Expands the tetrahedra of out in slots first up to first + leaves, each standing for stride leaves,
+// until each stands for until leaves. Works level by level instead of recursing: every tetrahedron is
+// replaced in place by its four children, spread out to the slots its subtree will end up in, in the order
+// the recursive version visited them. Only the slots given are touched.
+void expandTetrahedra(float* out, size_t first, size_t leaves, size_t stride, size_t until)
+{
+	// stride is the number of leaves under each tetrahedron of the current level.
+	for (; stride > until; stride /= 4)
+	{
+		size_t child = stride / 4;
+		for (size_t slot = first; slot < first + leaves; slot += stride)
+		{
+			float t[12];
+			for (int i = 0; i < 12; i++)
+			{
+				t[i] = out[slot * 12 + i];
+			}
+			float* pa = t;
+			float* pb = t + 3;
+			float* pc = t + 6;
+			float* pd = t + 9;
+
+			// Midpoints for all edges of the tetrahedron
+			float v0[3], v1[3], v2[3], v3[3], v4[3], v5[3];
+			for (int i = 0; i < 3; i++)
+			{
+				v0[i] = (pa[i] + pb[i]) / 2;
+				v1[i] = (pa[i] + pc[i]) / 2;
+				v2[i] = (pa[i] + pd[i]) / 2;
+				v3[i] = (pb[i] + pc[i]) / 2;
+				v4[i] = (pb[i] + pd[i]) / 2;
+				v5[i] = (pc[i] + pd[i]) / 2;
+			}
+
+			// Divide into smaller tetrahedra, the first one reuses the parent's slot.
+			float* children[4][4] =
+			{
+				{ pa, v0, v1, v2 },
+				{ v0, pb, v3, v4 },
+				{ v1, v3, pc, v5 },
+				{ v2, v4, v5, pd }
+			};
+			for (int k = 0; k < 4; k++)
+			{
+				float* dst = out + (slot + k * child) * 12;
+				for (int corner = 0; corner < 4; corner++)
+				{
+					for (int i = 0; i < 3; i++)
+					{
+						dst[corner * 3 + i] = children[k][corner][i];
+					}
+				}
+			}
+		}
+	}
 }
 
-// Function to divide the tetrahedron
-void divideTetrahedron(float* a, float* b, float* c, float* d, int m)
+// Function to divide the tetrahedron: fills out with the 4^m tetrahedra inside a, b, c, d, twelve floats each,
+// using threads threads. The top levels are expanded here, then every subtree below them is finished by its
+// own task in its own slice of out.
+void divideTetrahedron(float* a, float* b, float* c, float* d, int m, float* out, unsigned threads = subdivisionThreads())
 {
-	// Base case: if m is zero, draw the tetrahedron using the vertices.
-	if (m > 0)
+	size_t count = (size_t)1 << (2 * m);
+	for (int i = 0; i < 3; i++)
 	{
-		// Initialize midpoint vertices for the next level of tetrahedron.
-		float v0[3], v1[3], v2[3], v3[3], v4[3], v5[3];
-		// Midpoints for all edges of the tetrahedron
-		for (int i = 0; i < 3; i++)
+		out[i] = a[i];
+		out[3 + i] = b[i];
+		out[6 + i] = c[i];
+		out[9 + i] = d[i];
+	}
+
+	size_t split = splitStride(count, 4, threads);
+	expandTetrahedra(out, 0, count, count, split);
+	parallelTasks(count / split, threads, [&](size_t task)
+	{
+		expandTetrahedra(out, task * split, split, split, 1);
+	});
+}
+
+// Returns the mesh of the gasket at depth m, building and uploading it the first time that depth is shown.
+// Vertices shared by faces of the same color are welded. The children of a gasket only ever meet at
+// corners, so no face is ever inside the solid and every face is kept.
+const GasketMesh& gasketMesh(float vertices[4][3], int m)
+{
+	GasketMesh& mesh = meshes[m];
+	if (mesh.indexCount > 0)
+	{
+		return mesh;
+	}
+
+	size_t tetrahedra = (size_t)1 << (2 * m);
+	std::vector<float> leaves(tetrahedra * 12);
+	divideTetrahedron(vertices[0], vertices[1], vertices[2], vertices[3], m, leaves.data());
+
+	// The four faces of each tetrahedron with their colors, as drawTetrahedron drew them.
+	int faces[4][3] = { {0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3} };
+	float colors[4][3] = { {1.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 1.0} };
+
+	// Snap to a grid far finer than the smallest edge so equal midpoints get equal keys.
+	const double grid = 1 << 20;
+	std::unordered_map<WeldKey, uint32_t, WeldKeyHash> welded; // Position and color to vertex index
+	welded.reserve(tetrahedra * 4);
+	std::vector<float> vertexData; // Position then color per welded vertex
+	std::vector<uint32_t> indices; // Three vertex indices per face
+	indices.reserve(tetrahedra * 12);
+
+	for (size_t t = 0; t < tetrahedra; t++)
+	{
+		const float* corners = leaves.data() + t * 12;
+		uint32_t cornerIndex[4][4]; // Welded vertex per corner and color
+		for (int corner = 0; corner < 4; corner++)
 		{
-			v0[i] = (a[i] + b[i]) / 2;
-			v1[i] = (a[i] + c[i]) / 2;
-			v2[i] = (a[i] + d[i]) / 2;
-			v3[i] = (b[i] + c[i]) / 2;
-			v4[i] = (b[i] + d[i]) / 2;
-			v5[i] = (c[i] + d[i]) / 2;
+			for (int color = 0; color < 4; color++)
+			{
+				cornerIndex[corner][color] = (uint32_t)-1;
+			}
 		}
+		for (int f = 0; f < 4; f++)
+		{
+			for (int v = 0; v < 3; v++)
+			{
+				int corner = faces[f][v];
+				if (cornerIndex[corner][f] == (uint32_t)-1)
+				{
+					const float* p = corners + corner * 3;
+					WeldKey key = { std::llround(p[0] * grid), std::llround(p[1] * grid), std::llround(p[2] * grid), f };
+					auto inserted = welded.emplace(key, (uint32_t)welded.size());
+					if (inserted.second)
+					{
+						vertexData.insert(vertexData.end(), { p[0], p[1], p[2], colors[f][0], colors[f][1], colors[f][2] });
+					}
+					cornerIndex[corner][f] = inserted.first->second;
+				}
+				indices.push_back(cornerIndex[corner][f]);
+			}
+		}
+	}
 
-		// Recursively divide into smaller tetrahedra
-		divideTetrahedron(a, v0, v1, v2, m - 1);
-		divideTetrahedron(v0, b, v3, v4, m - 1);
-		divideTetrahedron(v1, v3, c, v5, m - 1);
-		divideTetrahedron(v2, v4, v5, d, m - 1);
+	glGenBuffers(1, &mesh.vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertexData.size() * sizeof(float), vertexData.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glGenBuffers(1, &mesh.ibo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	mesh.indexCount = (GLsizei)indices.size();
+	return mesh;
+}
+
+// Draws the gasket at depth m from its welded mesh in one call.
+void drawMesh(float vertices[4][3], int m)
+{
+	const GasketMesh& mesh = gasketMesh(vertices, m);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ibo);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), (void*)0);
+	glColorPointer(3, GL_FLOAT, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	glDrawElements(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT, (void*)0);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Compiles and links a vertex and fragment shader, printing the log if either fails.
+GLuint buildProgram(const char* vertexSource, const char* fragmentSource)
+{
+	GLuint program = glCreateProgram();
+	const char* sources[2] = { vertexSource, fragmentSource };
+	GLenum types[2] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER };
+	for (int i = 0; i < 2; i++)
+	{
+		GLuint shader = glCreateShader(types[i]);
+		glShaderSource(shader, 1, &sources[i], NULL);
+		glCompileShader(shader);
+		GLint success;
+		glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			char log[1024];
+			glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+			std::cout << "Shader compilation failed:" << std::endl << log << std::endl;
+		}
+		glAttachShader(program, shader);
+		glDeleteShader(shader);
 	}
-	else
+	glLinkProgram(program);
+	GLint success;
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success)
 	{
-		// Draw the tetrahedron using given vertices when no further subdivision is needed
-		drawTetrahedron(a, b, c, d);
+		char log[1024];
+		glGetProgramInfoLog(program, sizeof(log), NULL, log);
+		std::cout << "Shader linking failed:" << std::endl << log << std::endl;
 	}
+	return program;
+}
+
+// Draws the gasket at depth m as 4^m instances of one tetrahedron, memory used does not grow with depth.
+void drawInstanced(float vertices[4][3], int m)
+{
+	if (instanceProgram == 0)
+	{
+		instanceProgram = buildProgram(instanceVertexShader, instanceFragmentShader);
+
+		// The four faces of drawTetrahedron with their colors, six floats per vertex.
+		int faces[4][3] = { {0, 1, 2}, {0, 1, 3}, {0, 2, 3}, {1, 2, 3} };
+		float colors[4][3] = { {1.0, 0.0, 0.0}, {1.0, 1.0, 0.0}, {1.0, 0.0, 1.0}, {0.0, 0.0, 1.0} };
+		float base[12][6];
+		for (int f = 0; f < 4; f++)
+		{
+			for (int v = 0; v < 3; v++)
+			{
+				for (int i = 0; i < 3; i++)
+				{
+					base[f * 3 + v][i] = vertices[faces[f][v]][i];
+					base[f * 3 + v][3 + i] = colors[f][i];
+				}
+			}
+		}
+		glGenBuffers(1, &baseVBO);
+		glBindBuffer(GL_ARRAY_BUFFER, baseVBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(base), base, GL_STATIC_DRAW);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	// Digits 0 to 3 shrink towards a, b, c and d, the same children divideTetrahedron makes.
+	GLsizei instances = 1 << (2 * m);
+
+	glUseProgram(instanceProgram);
+	glUniform3fv(glGetUniformLocation(instanceProgram, "corners"), 4, &vertices[0][0]);
+	glUniform1i(glGetUniformLocation(instanceProgram, "depth"), m);
+	glBindBuffer(GL_ARRAY_BUFFER, baseVBO);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 6 * sizeof(float), (void*)0);
+	glColorPointer(3, GL_FLOAT, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+	glDrawArraysInstanced(GL_TRIANGLES, 0, 12, instances);
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glUseProgram(0);
 }
 
 // Drawing routine.
@@ -108,7 +359,14 @@ void drawScene(void)
 	glLoadIdentity();
 	glRotatef(Angle, 1.0, 1.0, 0.5);
 
-	divideTetrahedron(vertices[0], vertices[1], vertices[2], vertices[3], fractals); // first call to initiate recursive calls where n = fractals
+	if (instanced)
+	{
+		drawInstanced(vertices, fractals);
+	}
+	else
+	{
+		drawMesh(vertices, fractals);
+	}
 
 	glutSwapBuffers();
 }
@@ -117,6 +375,7 @@ void drawScene(void)
 void setup(void)
 {
 	glClearColor(1.0, 1.0, 1.0, 0.0);
+	glEnable(GL_DEPTH_TEST); // Make sure to enable the depth test otherwise it will not display correctly.
 }
 
 // OpenGL window reshape routine.
@@ -149,6 +408,15 @@ void keyInput(unsigned char key, int x, int y)
 		}
 		glutPostRedisplay();
 		break;
+	case 'i': // switch between the welded mesh and instanced drawing.
+		instanced = !instanced;
+		if (!instanced && fractals > maxMeshFractals)
+		{
+			fractals = maxMeshFractals; // deeper levels are only drawn instanced
+		}
+		std::cout << (instanced ? "Instanced drawing." : "Welded mesh.") << std::endl;
+		glutPostRedisplay();
+		break;
 	case 27: // escape will leave the program
 		exit(0);
 		break;
@@ -162,7 +430,15 @@ void specialKeyInput(int key, int x, int y)
 {
 	if (key == GLUT_KEY_UP)
 	{
-		fractals += 1; // increase number of fractals by 1
+		int deepest = instanced ? maxFractals : maxMeshFractals;
+		if (fractals == deepest)
+		{
+			std::cout << "Deepest level is " << deepest << (instanced ? "." : ", press i to go deeper instanced.") << std::endl; // each level draws four times as much
+		}
+		else
+		{
+			fractals += 1; // increase number of fractals by 1
+		}
 	}
 	if (key == GLUT_KEY_DOWN)
 	{
@@ -185,12 +461,29 @@ void printInteraction(void)
 	std::cout << "Press the up arrow key to increase number of fractals." << std::endl
 		<< "Press the down arrow key to decrease number of fractals." << std::endl
 		<< "Press the space bar to rotate the fractal." << std::endl
+		<< "Press i to switch between the welded mesh and instanced drawing." << std::endl
 		<< "Press r to reset." << std::endl;
 }
 
+// Times generating the gasket on one thread and on every core, no window needed.
+void runBenchmark(void)
+{
+	float vertices[4][3] = { {0.0, 1.0, 0.0}, {-1.0, -0.5, -0.5}, {1.0, -0.5, -0.5}, {0.0, -0.5, 1.0} };
+	benchmarkSubdivision("Sierpinski tetrahedron", 4, 12, [&](int m, float* out, unsigned threads)
+	{
+		divideTetrahedron(vertices[0], vertices[1], vertices[2], vertices[3], m, out, threads);
+	});
+}
+
 // Main routine.
 int main(int argc, char** argv)
 {
+	if (argc > 1 && strcmp(argv[1], "--benchmark") == 0)
+	{
+		runBenchmark();
+		return 0;
+	}
+
 	printInteraction();
 	glutInit(&argc, argv);
 
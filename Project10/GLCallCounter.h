@@ -0,0 +1,79 @@
+#ifndef GL_CALL_COUNTER_H
+#define GL_CALL_COUNTER_H
+
+#include <GL/glew.h> // Glew include
+
+#include <iostream> // Include iostream
+
+// Tallies the GL calls issued during one frame so the render loop can be audited.
+// Wrap the calls of interest with the forwarding methods below and Reset() at the top of every frame.
+class GLCallCounter
+{
+public:
+	unsigned int drawCalls = 0; // glDrawArrays / glDrawElements / glMultiDrawElementsIndirect calls
+	unsigned int bufferUploads = 0; // glBufferData / glBufferSubData calls
+	unsigned int programBinds = 0; // glUseProgram calls
+	unsigned int uniformLookups = 0; // glGetUniformLocation calls
+	unsigned int matrixBuilds = 0; // Projection / view matrix rebuilds
+
+	// Clears every counter, call once at the start of a frame
+	void Reset()
+	{
+		drawCalls = 0; // Reset draw calls
+		bufferUploads = 0; // Reset buffer uploads
+		programBinds = 0; // Reset program binds
+		uniformLookups = 0; // Reset uniform lookups
+		matrixBuilds = 0; // Reset matrix builds
+	}
+
+	// Prints the counters gathered for the last frame
+	void Print() const
+	{
+		std::cout << "GL calls per frame: draws " << drawCalls // Print draw calls
+			<< ", buffer uploads " << bufferUploads // Print buffer uploads
+			<< ", program binds " << programBinds // Print program binds
+			<< ", uniform lookups " << uniformLookups // Print uniform lookups
+			<< ", matrix builds " << matrixBuilds << std::endl; // Print matrix builds
+	}
+
+	// Counting forwarders for the GL entry points we care about
+	GLint UniformLocation(GLuint program, const GLchar* name)
+	{
+		uniformLookups++; // Count lookup
+		return glGetUniformLocation(program, name); // Forward to GL
+	}
+
+	void UseProgram(GLuint program)
+	{
+		programBinds++; // Count program bind
+		glUseProgram(program); // Forward to GL
+	}
+
+	void DrawArrays(GLenum mode, GLint first, GLsizei count)
+	{
+		drawCalls++; // Count draw
+		glDrawArrays(mode, first, count); // Forward to GL
+	}
+
+	void DrawElements(GLenum mode, GLsizei count, GLenum type, const void* indices)
+	{
+		drawCalls++; // Count draw
+		glDrawElements(mode, count, type, indices); // Forward to GL
+	}
+
+	void MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride)
+	{
+		drawCalls++; // One call no matter how many meshes it submits
+		glMultiDrawElementsIndirect(mode, type, indirect, drawCount, stride); // Forward to GL
+	}
+
+	void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+	{
+		bufferUploads++; // Count upload
+		glBufferData(target, size, data, usage); // Forward to GL
+	}
+};
+
+inline GLCallCounter glCalls; // Single per-frame counter shared by the shader, mesh and main loop, one for the whole program (C++17)
+
+#endif
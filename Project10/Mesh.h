@@ -11,6 +11,8 @@ using namespace std; // Use namespace std
 #include <glm/glm.hpp> // Include glm
 #include <glm/gtc/matrix_transform.hpp> // Include matrix transform
 
+#include "GLCallCounter.h" // Include per-frame GL call counter
+
 
 // Define vertex structure
 struct Vertex {
@@ -67,17 +69,17 @@ public:
                 ss << specularNr++; // Transfer GLuint to stream
             number = ss.str(); // Set number equal to string of ss
             // Now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i); // Set sampler to texture unit
+            glUniform1i(glCalls.UniformLocation(shader.ID, (name + number).c_str()), i); // Set sampler to texture unit
             // And finally bind the texture
             glBindTexture(GL_TEXTURE_2D, this->textures[i].id); // Bind
         }
         
         // Also set each mesh's shininess property to a default value (if you want you could extend this to another mesh property and possibly change this value)
-        glUniform1f(glGetUniformLocation(shader.ID, "material.shininess"), 16.0f);
+        glUniform1f(glCalls.UniformLocation(shader.ID, "material.shininess"), 16.0f);
 
         // Draw mesh
         glBindVertexArray(this->VAO); // Bind VAO
-        glDrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0); // Draw GL_TRIANGLES
+        glCalls.DrawElements(GL_TRIANGLES, this->indices.size(), GL_UNSIGNED_INT, 0); // Draw GL_TRIANGLES
         glBindVertexArray(0); // Bind 0
 
         // Always good practice to set everything back to defaults once configured.
@@ -88,6 +90,10 @@ public:
         }
     }
 
+    // Accessors used by the render queue to draw the mesh without going through Draw()
+    GLuint GetVAO() const { return this->VAO; } // Return VAO
+    GLsizei GetIndexCount() const { return (GLsizei)this->indices.size(); } // Return index count
+
 private:
     /*  Render data  */
     GLuint VAO, VBO, EBO; // Initialize VAO, VBO, EBO
@@ -0,0 +1,335 @@
+#ifndef MESH_BATCH_H
+#define MESH_BATCH_H
+
+#include <GL/glew.h> // Glew include
+#include <glm/glm.hpp> // GLM include
+
+#include <algorithm> // Include algorithm for min/max
+#include <cmath> // Include cmath for sqrt
+#include <vector> // Include vector
+
+#include "Model.h" // Include Model class
+#include "GLCallCounter.h" // Include per-frame GL call counter
+#include "RingBuffer.h" // Include per-frame stream buffer
+#include "RenderQueue.h" // Include ObjectTransform
+
+// Layout glMultiDrawElementsIndirect reads from the indirect buffer
+struct DrawElementsIndirectCommand {
+	GLuint count; // Index count
+	GLuint instanceCount; // Number of instances, always 1
+	GLuint firstIndex; // Offset into the shared index buffer
+	GLint baseVertex; // Offset into the shared vertex buffer
+	GLuint baseInstance; // Unused, 0
+};
+
+// Per-draw data fetched by batch.vs through gl_DrawID (std430, binding 0)
+struct BatchDrawData {
+	glm::mat4 model; // World matrix
+	glm::mat4 normalMatrix; // Inverse transpose of the world matrix, mat4 to keep std430 alignment simple
+	GLuint material; // Index into the material buffer
+	GLuint pad[3]; // Pad to 16 bytes
+};
+
+// Per-material data fetched by batch.frag (std430, binding 1)
+struct BatchMaterial {
+	glm::vec4 color; // Material colour
+	GLuint textureLayer; // Layer of the texture array holding the material's texture
+	GLuint pad[3]; // Pad to 16 bytes
+};
+
+// Packs the meshes of several models into one vertex/index buffer so that every visible mesh
+// can be submitted with a single glMultiDrawElementsIndirect call. Requires OpenGL 4.6 (gl_DrawID).
+class MeshBatch
+{
+public:
+	// True when the context can run the indirect path
+	static bool Supported()
+	{
+		return GLEW_VERSION_4_6; // gl_DrawID and multi draw indirect are core in 4.6
+	}
+
+	// Adds every mesh of a model to the shared buffers, returns the model's index for Add
+	unsigned int AddModel(const Model& model)
+	{
+		ModelRange range; // Initialize model range
+		range.firstMesh = (unsigned int)meshes.size(); // First mesh of the model
+		for (const Mesh& mesh : model.GetMeshes()) // Iterate over meshes
+		{
+			MeshRange m; // Initialize mesh range
+			m.firstIndex = (GLuint)indices.size(); // Indices start after the previous mesh
+			m.count = (GLuint)mesh.indices.size(); // Index count
+			m.baseVertex = (GLint)vertices.size(); // Vertices start after the previous mesh
+			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end()); // Append vertices
+			indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end()); // Append indices
+			computeBounds(mesh, m); // Bounding sphere for culling
+			meshes.push_back(m); // Store mesh range
+		}
+		range.meshCount = (unsigned int)meshes.size() - range.firstMesh; // Number of meshes in the model
+		models.push_back(range); // Store model range
+		return (unsigned int)(models.size() - 1); // Return its index
+	}
+
+	// Adds a material, textures get consecutive layers of the batch's texture array in the order they are first seen
+	unsigned int AddMaterial(const glm::vec3& color, GLuint texture)
+	{
+		BatchMaterial material; // Initialize material
+		material.color = glm::vec4(color, 1.0f); // Set colour
+		material.textureLayer = textureLayer(texture); // Find or assign layer
+		materials.push_back(material); // Store material
+		return (unsigned int)(materials.size() - 1); // Return its index
+	}
+
+	// Creates the GL objects, call once after every model and material has been added
+	void Upload()
+	{
+		glGenVertexArrays(1, &VAO); // Create VAO
+		glGenBuffers(1, &VBO); // Create shared vertex buffer
+		glGenBuffers(1, &EBO); // Create shared index buffer
+		glGenBuffers(1, &materialBuffer); // Create material SSBO
+
+		glBindVertexArray(VAO); // Bind VAO
+		glBindBuffer(GL_ARRAY_BUFFER, VBO); // Bind vertex buffer
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW); // Upload every mesh's vertices once
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO); // Bind index buffer
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), indices.data(), GL_STATIC_DRAW); // Upload every mesh's indices once
+		// Same attribute layout as Mesh::setupMesh
+		glEnableVertexAttribArray(0); // Enable position
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0); // Position
+		glEnableVertexAttribArray(1); // Enable normal
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, Normal)); // Normal
+		glEnableVertexAttribArray(2); // Enable texture coordinates
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offsetof(Vertex, TexCoords)); // Texture coordinates
+		glBindVertexArray(0); // Unbind VAO
+
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer); // Bind material SSBO
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(BatchMaterial), materials.data(), GL_STATIC_DRAW); // Materials never change
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0); // Unbind SSBO
+
+		buildTextureArray(); // Copy every material texture into one array
+
+		vertices.clear(); vertices.shrink_to_fit(); // CPU copy no longer needed
+		indices.clear(); indices.shrink_to_fit(); // CPU copy no longer needed
+	}
+
+	// Starts a new frame, planes are taken from projection * view for culling
+	void Begin(const glm::mat4& viewProjection)
+	{
+		extractPlanes(viewProjection); // Update frustum
+		commands.clear(); // Drop last frame's commands
+		draws.clear(); // Drop last frame's draw data
+		culled = 0; // Reset culled count
+	}
+
+	// Queues every visible mesh of a model
+	void Add(unsigned int model, unsigned int material, const ObjectTransform& transform)
+	{
+		const ModelRange& range = models[model]; // Model's meshes
+		float scale = maxScale(transform.model); // Largest axis scale for the bounding radius
+		for (unsigned int i = range.firstMesh; i < range.firstMesh + range.meshCount; i++) // Iterate over meshes
+		{
+			const MeshRange& mesh = meshes[i]; // Mesh range
+			glm::vec4 center = transform.model * glm::vec4(mesh.center, 1.0f); // World space centre
+			if (!visible(glm::vec3(center.x, center.y, center.z), mesh.radius * scale)) // Outside the frustum
+			{
+				culled++; // Count culled mesh
+				continue; // Skip it
+			}
+			DrawElementsIndirectCommand command; // Initialize command
+			command.count = mesh.count; // Index count
+			command.instanceCount = 1; // One instance
+			command.firstIndex = mesh.firstIndex; // Index offset
+			command.baseVertex = mesh.baseVertex; // Vertex offset
+			command.baseInstance = 0; // Unused
+			commands.push_back(command); // Queue command
+
+			BatchDrawData data; // Initialize draw data
+			data.model = transform.model; // World matrix
+			data.normalMatrix = transform.normalMatrix; // Normal matrix
+			data.material = material; // Material index
+			draws.push_back(data); // Queue draw data, index matches gl_DrawID
+		}
+	}
+
+	// Streams this frame's commands and draw data through ring and submits them with one call. The batch program must be bound.
+	void Draw(RingBuffer& ring)
+	{
+		if (commands.empty()) // Nothing visible
+			return;
+
+		GLsizeiptr commandBytes = commands.size() * sizeof(DrawElementsIndirectCommand); // Command bytes
+		GLsizeiptr drawBytes = draws.size() * sizeof(BatchDrawData); // Draw data bytes
+		GLintptr commandOffset = ring.Write(commands.data(), commandBytes); // memcpy commands into the ring
+		GLintptr drawOffset = ring.Write(draws.data(), drawBytes); // memcpy draw data into the ring
+		if (commandOffset < 0 || drawOffset < 0) // Ring section was full
+			return;
+		ring.Commit(); // Make them visible
+
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ring.ID); // Commands are read from the ring
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, ring.ID, drawOffset, drawBytes); // Draw data at binding 0
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, materialBuffer); // Materials at binding 1
+
+		glActiveTexture(GL_TEXTURE0); // Texture array is read from unit 0
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray); // Every material texture, one per layer
+
+		glBindVertexArray(VAO); // Bind shared VAO
+		glCalls.MultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)commandOffset, (GLsizei)commands.size(), 0); // One call for every visible mesh
+		glBindVertexArray(0); // Unbind VAO
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0); // Unbind indirect buffer
+	}
+
+	// Points the texture array sampler at unit 0, call once with the batch program in use
+	void BindSamplers(GLuint program) const
+	{
+		glUniform1i(glGetUniformLocation(program, "textures"), 0); // Sampler reads unit 0
+	}
+
+	GLsizei DrawCount() const { return (GLsizei)commands.size(); } // Meshes submitted this frame
+	unsigned int CulledCount() const { return culled; } // Meshes culled this frame
+
+private:
+	// Location of one mesh inside the shared buffers
+	struct MeshRange {
+		GLuint firstIndex; // First index
+		GLuint count; // Index count
+		GLint baseVertex; // First vertex
+		glm::vec3 center; // Bounding sphere centre, model space
+		float radius; // Bounding sphere radius, model space
+	};
+
+	// Meshes belonging to one model
+	struct ModelRange {
+		unsigned int firstMesh; // First mesh
+		unsigned int meshCount; // Number of meshes
+	};
+
+	vector<Vertex> vertices; // Shared vertices, freed after Upload
+	vector<GLuint> indices; // Shared indices, freed after Upload
+	vector<MeshRange> meshes; // Every mesh in the batch
+	vector<ModelRange> models; // Every model in the batch
+	vector<BatchMaterial> materials; // Every material in the batch
+	vector<GLuint> layerTextures; // Texture copied into each layer
+	vector<DrawElementsIndirectCommand> commands; // This frame's commands
+	vector<BatchDrawData> draws; // This frame's draw data
+	glm::vec4 planes[6]; // Frustum planes
+	unsigned int culled = 0; // Meshes culled this frame
+	GLuint VAO = 0, VBO = 0, EBO = 0; // Shared geometry
+	GLuint materialBuffer = 0; // Static material buffer
+	GLuint textureArray = 0; // Material textures, one per layer
+
+	// Returns the layer holding a texture, assigning the next one the first time
+	GLuint textureLayer(GLuint texture)
+	{
+		for (unsigned int i = 0; i < layerTextures.size(); i++) // Search assigned layers
+			if (layerTextures[i] == texture) // Already assigned
+				return i; // Reuse layer
+		layerTextures.push_back(texture); // Assign next layer
+		return (GLuint)(layerTextures.size() - 1); // Return it
+	}
+
+	// Copies every material texture into a layer of one 2D array texture, scaled to the largest of them.
+	// Inside one multi draw the material differs between sub-draws, so batch.frag cannot pick a sampler by it;
+	// a layer index is only a texture coordinate and may differ per fragment.
+	void buildTextureArray()
+	{
+		GLint width = 1, height = 1; // Layer size, the largest texture
+		for (GLuint texture : layerTextures) // Iterate over textures
+		{
+			GLint w = 0, h = 0; // Texture size
+			glBindTexture(GL_TEXTURE_2D, texture); // Bind texture
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w); // Query width
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h); // Query height
+			width = std::max(width, w); // Grow width
+			height = std::max(height, h); // Grow height
+		}
+		glBindTexture(GL_TEXTURE_2D, 0); // Unbind texture
+		GLint levels = 1; // Full mipmap chain
+		while ((width >> levels) > 0 || (height >> levels) > 0)
+			levels++;
+		GLsizei layers = std::max<GLsizei>((GLsizei)layerTextures.size(), 1); // At least one layer
+
+		glGenTextures(1, &textureArray); // Create array
+		glBindTexture(GL_TEXTURE_2D_ARRAY, textureArray); // Bind array
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, width, height, layers); // Allocate every layer and level
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT); // Same sampling as loadTexture
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		GLuint framebuffers[2]; // Read from the texture, draw into the layer
+		glGenFramebuffers(2, framebuffers); // Create framebuffers
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffers[0]); // Source
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffers[1]); // Destination
+		for (GLint layer = 0; layer < (GLint)layerTextures.size(); layer++) // Iterate over layers
+		{
+			GLint w = 0, h = 0; // Source size
+			glBindTexture(GL_TEXTURE_2D, layerTextures[layer]); // Bind source
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w); // Query width
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h); // Query height
+			glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, layerTextures[layer], 0); // Read level 0
+			glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, textureArray, 0, layer); // Write the layer
+			glBlitFramebuffer(0, 0, w, h, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR); // Copy, scaling to the layer size
+		}
+		glBindTexture(GL_TEXTURE_2D, 0); // Unbind source
+		glBindFramebuffer(GL_FRAMEBUFFER, 0); // Back to the window
+		glDeleteFramebuffers(2, framebuffers); // Framebuffers no longer needed
+		glGenerateMipmap(GL_TEXTURE_2D_ARRAY); // Mipmaps of every layer
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0); // Unbind array
+	}
+
+	// Computes a model space bounding sphere from the mesh's axis aligned box
+	void computeBounds(const Mesh& mesh, MeshRange& range)
+	{
+		glm::vec3 lo(1e30f), hi(-1e30f); // Initialize box
+		for (const Vertex& v : mesh.vertices) // Iterate over vertices
+			for (int k = 0; k < 3; k++) // Iterate over axes
+			{
+				lo[k] = std::min(lo[k], v.Position[k]); // Grow minimum
+				hi[k] = std::max(hi[k], v.Position[k]); // Grow maximum
+			}
+		range.center = (lo + hi) * 0.5f; // Box centre
+		range.radius = 0.0f; // Initialize radius
+		for (const Vertex& v : mesh.vertices) // Iterate over vertices
+		{
+			glm::vec3 d = v.Position - range.center; // Offset from centre
+			range.radius = std::max(range.radius, (float)std::sqrt(glm::dot(d, d))); // Farthest vertex
+		}
+	}
+
+	// Gribb/Hartmann plane extraction from a column major matrix
+	void extractPlanes(const glm::mat4& m)
+	{
+		for (int i = 0; i < 3; i++) // Left/right, bottom/top, near/far
+		{
+			for (int k = 0; k < 4; k++) // Row 3 plus or minus row i
+			{
+				planes[2 * i][k] = m[k][3] + m[k][i]; // Positive side plane
+				planes[2 * i + 1][k] = m[k][3] - m[k][i]; // Negative side plane
+			}
+		}
+		for (int i = 0; i < 6; i++) // Normalize so distances are in world units
+		{
+			float length = std::sqrt(planes[i].x * planes[i].x + planes[i].y * planes[i].y + planes[i].z * planes[i].z); // Normal length
+			planes[i] = glm::vec4(planes[i].x / length, planes[i].y / length, planes[i].z / length, planes[i].w / length); // Normalize plane
+		}
+	}
+
+	// Sphere against all six planes
+	bool visible(const glm::vec3& center, float radius) const
+	{
+		for (int i = 0; i < 6; i++) // Iterate over planes
+			if (planes[i].x * center.x + planes[i].y * center.y + planes[i].z * center.z + planes[i].w < -radius) // Fully behind plane
+				return false;
+		return true;
+	}
+
+	// Largest column length of the upper 3x3, scales the bounding radius
+	static float maxScale(const glm::mat4& m)
+	{
+		float s = 0.0f; // Initialize scale
+		for (int i = 0; i < 3; i++) // Iterate over axes
+			s = std::max(s, (float)std::sqrt(m[i].x * m[i].x + m[i].y * m[i].y + m[i].z * m[i].z)); // Column length
+		return s;
+	}
+};
+
+#endif
@@ -36,6 +36,12 @@ public:
 		for(GLuint i = 0; i < this->meshes.size(); i++) // Iterate over mesh
 			this->meshes[i].Draw(shader); // Draw
 	}
+
+	// Gives the render queue access to the loaded meshes
+	const vector<Mesh>& GetMeshes() const
+	{
+		return this->meshes; // Return meshes
+	}
 	
 private:
 	/*  Model Data  */
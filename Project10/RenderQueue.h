@@ -0,0 +1,221 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <GL/glew.h> // Glew include
+#include <glm/glm.hpp> // GLM include
+#include <glm/gtc/type_ptr.hpp> // GLM value_ptr include
+
+#include <algorithm> // Include algorithm for sort
+#include <cstdint> // Include fixed width integers
+#include <vector> // Include vector
+
+#include "shader_m.h" // Include Shader class
+#include "Model.h" // Include Model class
+#include "GLCallCounter.h" // Include per-frame GL call counter
+#include "RingBuffer.h" // Include per-frame stream buffer
+
+// A linked program with every uniform location the queue touches, looked up once at registration
+struct ProgramState {
+	GLuint id; // Program handle
+	GLint view; // view uniform
+	GLint projection; // projection uniform
+	GLint lightColor; // lightColor uniform
+	GLint lightPos; // lightPos uniform
+	GLint viewPos; // viewPos uniform
+	GLint cameraPos; // cameraPos uniform (cubemap reflection)
+	GLint color; // Per-material colour uniform, -1 when the program has none
+	unsigned int frameStamp; // Last frame the per-frame uniforms were uploaded
+};
+
+// Surface description shared by many packets
+struct Material {
+	glm::vec3 color; // Colour passed to the program's colour uniform
+	GLenum textureTarget; // GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP
+	GLuint texture; // Texture bound to unit 0, 0 for none
+};
+
+// Values that are constant for a whole frame
+struct FrameUniforms {
+	glm::mat4 view; // Camera view matrix
+	glm::mat4 projection; // Projection matrix
+	glm::vec3 lightPos; // Light position
+	glm::vec3 lightColor; // Light colour
+	glm::vec3 viewPos; // Camera position
+	unsigned int frame; // Frame number, used to upload the values above once per program
+};
+
+// World and normal matrix of an object, laid out like the shaders' std140 Object block.
+// Built once when the object is placed, not per frame or per vertex.
+struct ObjectTransform {
+	glm::mat4 model; // World matrix
+	glm::mat4 normalMatrix; // Inverse transpose of model, mat4 so std140 needs no padding
+
+	ObjectTransform() : model(1.0f), normalMatrix(1.0f) {} // Identity placement
+	explicit ObjectTransform(const glm::mat4& model) : model(model), normalMatrix(glm::transpose(glm::inverse(model))) {} // Inverse transpose computed once
+};
+
+// Everything needed to issue one draw
+struct DrawPacket {
+	uint64_t key; // Sort key: program | texture | VAO | material, most expensive state in the high bits
+	unsigned short program; // Index into the queue's programs
+	unsigned short material; // Index into the queue's materials
+	GLuint vao; // Vertex array to bind
+	GLsizei count; // Vertex or index count
+	bool indexed; // glDrawElements when true, glDrawArrays otherwise
+	const ObjectTransform* transform; // Object placement, owned by the caller and kept alive until Flush
+};
+
+// Uniform buffer binding of the per-object block the vertex shaders declare
+const GLuint ObjectBlockBinding = 1;
+
+// Collects draw packets during the frame and submits them sorted by state in a single pass
+class RenderQueue
+{
+public:
+	unsigned int programSwitches = 0; // Program changes during the last Flush
+	unsigned int textureSwitches = 0; // Texture changes during the last Flush
+	unsigned int vaoSwitches = 0; // VAO changes during the last Flush
+
+	// Registers a program and caches its uniform locations, returns its index for Submit
+	unsigned short AddProgram(const Shader& shader, const char* colorUniform)
+	{
+		ProgramState p; // Initialize program state
+		p.id = shader.ID; // Set program handle
+		p.view = glGetUniformLocation(shader.ID, "view"); // Cache view location
+		GLuint objectBlock = glGetUniformBlockIndex(shader.ID, "Object"); // Per-object uniform block
+		if (objectBlock != GL_INVALID_INDEX) // Program declares the block
+			glUniformBlockBinding(shader.ID, objectBlock, ObjectBlockBinding); // Read it from the object binding
+		p.projection = glGetUniformLocation(shader.ID, "projection"); // Cache projection location
+		p.lightColor = glGetUniformLocation(shader.ID, "lightColor"); // Cache lightColor location
+		p.lightPos = glGetUniformLocation(shader.ID, "lightPos"); // Cache lightPos location
+		p.viewPos = glGetUniformLocation(shader.ID, "viewPos"); // Cache viewPos location
+		p.cameraPos = glGetUniformLocation(shader.ID, "cameraPos"); // Cache cameraPos location
+		p.color = colorUniform ? glGetUniformLocation(shader.ID, colorUniform) : -1; // Cache colour location if any
+		p.frameStamp = ~0u; // Never uploaded yet
+		programs.push_back(p); // Store program
+		return (unsigned short)(programs.size() - 1); // Return its index
+	}
+
+	// Registers a material, returns its index for Submit
+	unsigned short AddMaterial(const Material& material)
+	{
+		materials.push_back(material); // Store material
+		return (unsigned short)(materials.size() - 1); // Return its index
+	}
+
+	// Queues one draw of a vertex array
+	void Submit(unsigned short program, unsigned short material, GLuint vao, GLsizei count, bool indexed, const ObjectTransform& transform)
+	{
+		DrawPacket packet; // Initialize packet
+		packet.program = program; // Set program index
+		packet.material = material; // Set material index
+		packet.vao = vao; // Set VAO
+		packet.count = count; // Set count
+		packet.indexed = indexed; // Set draw type
+		packet.transform = &transform; // Set placement
+		packet.key = ((uint64_t)program << 48) // Program switches cost the most
+			| ((uint64_t)(materials[material].texture & 0xFFFF) << 32) // Then texture binds
+			| ((uint64_t)(vao & 0xFFFF) << 16) // Then vertex array binds
+			| (uint64_t)material; // Then material uniforms
+		packets.push_back(packet); // Queue packet
+	}
+
+	// Queues every mesh of a model with the same placement
+	void SubmitModel(unsigned short program, unsigned short material, const Model& model, const ObjectTransform& transform)
+	{
+		for (const Mesh& mesh : model.GetMeshes()) // Iterate over meshes
+			Submit(program, material, mesh.GetVAO(), mesh.GetIndexCount(), true, transform); // Queue mesh
+	}
+
+	// Sorts the queued packets, issues them and empties the queue. Per-object matrices are streamed through ring.
+	void Flush(const FrameUniforms& frame, RingBuffer& ring)
+	{
+		std::stable_sort(packets.begin(), packets.end(), // Stable so equal keys keep submission order
+			[](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+
+		// Write every packet's object block into this frame's section before drawing
+		objectOffsets.resize(packets.size()); // One offset per packet
+		for (size_t i = 0; i < packets.size(); i++) // Iterate over packets
+			objectOffsets[i] = ring.Write(packets[i].transform, sizeof(ObjectTransform)); // memcpy the cached matrices into the ring
+		ring.Commit(); // Make the blocks visible
+
+		programSwitches = textureSwitches = vaoSwitches = 0; // Reset switch counters
+		int currentProgram = -1; // Nothing bound yet
+		int currentMaterial = -1; // No material uploaded yet
+		GLuint currentTexture = 0; // Texture bound to unit 0
+		GLuint currentVAO = 0; // Bound vertex array
+		glActiveTexture(GL_TEXTURE0); // Every material samples from unit 0
+
+		for (size_t i = 0; i < packets.size(); i++) // Single pass over the sorted packets
+		{
+			const DrawPacket& packet = packets[i]; // Current packet
+			ProgramState& program = programs[packet.program]; // Packet's program
+			const Material& material = materials[packet.material]; // Packet's material
+
+			if (packet.program != currentProgram) // Program change
+			{
+				glCalls.UseProgram(program.id); // Bind program
+				programSwitches++; // Count switch
+				currentProgram = packet.program; // Remember program
+				currentMaterial = -1; // Material uniforms belong to the program, re-upload
+				if (program.frameStamp != frame.frame) // First use of this program this frame
+				{
+					uploadFrameUniforms(program, frame); // Upload per-frame values once
+					program.frameStamp = frame.frame; // Mark as uploaded
+				}
+			}
+			if (material.texture != currentTexture) // Texture change
+			{
+				if (material.texture != 0) // Checkerboard tiles draw untextured and keep whatever is bound
+				{
+					glBindTexture(material.textureTarget, material.texture); // Bind texture
+					textureSwitches++; // Count switch
+					currentTexture = material.texture; // Remember texture
+				}
+			}
+			if (packet.vao != currentVAO) // Vertex array change
+			{
+				glBindVertexArray(packet.vao); // Bind VAO
+				vaoSwitches++; // Count switch
+				currentVAO = packet.vao; // Remember VAO
+			}
+			if (packet.material != currentMaterial) // Material change
+			{
+				if (program.color != -1) // Program has a colour uniform
+					glUniform3fv(program.color, 1, glm::value_ptr(material.color)); // Upload colour
+				currentMaterial = packet.material; // Remember material
+			}
+
+			if (objectOffsets[i] < 0) // Ring section was full
+				continue; // Skip the draw rather than read stale data
+			glBindBufferRange(GL_UNIFORM_BUFFER, ObjectBlockBinding, ring.ID, objectOffsets[i], sizeof(ObjectTransform)); // Point the object block at this packet's matrices
+
+			if (packet.indexed) // Indexed mesh
+				glCalls.DrawElements(GL_TRIANGLES, packet.count, GL_UNSIGNED_INT, 0); // Draw elements
+			else
+				glCalls.DrawArrays(GL_TRIANGLES, 0, packet.count); // Draw arrays
+		}
+
+		glBindVertexArray(0); // Unbind VAO
+		packets.clear(); // Empty the queue, capacity is kept for the next frame
+	}
+
+private:
+	std::vector<ProgramState> programs; // Registered programs
+	std::vector<Material> materials; // Registered materials
+	std::vector<DrawPacket> packets; // Packets queued this frame
+	std::vector<GLintptr> objectOffsets; // Ring offset of each packet's object block
+
+	// Uploads the values shared by every packet drawn with this program
+	void uploadFrameUniforms(const ProgramState& program, const FrameUniforms& frame)
+	{
+		glUniformMatrix4fv(program.view, 1, GL_FALSE, glm::value_ptr(frame.view)); // Upload view
+		glUniformMatrix4fv(program.projection, 1, GL_FALSE, glm::value_ptr(frame.projection)); // Upload projection
+		glUniform3fv(program.lightColor, 1, glm::value_ptr(frame.lightColor)); // Upload light colour
+		glUniform3fv(program.lightPos, 1, glm::value_ptr(frame.lightPos)); // Upload light position
+		glUniform3fv(program.viewPos, 1, glm::value_ptr(frame.viewPos)); // Upload camera position
+		glUniform3fv(program.cameraPos, 1, glm::value_ptr(frame.viewPos)); // Upload camera position for reflections
+	}
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <GL/glew.h> // Glew include
+
+#include <cstring> // Include memcpy
+#include <iostream> // Include iostream
+#include <vector> // Include vector
+
+#include "GLCallCounter.h" // Include per-frame GL call counter
+
+// Triple buffered stream buffer for per-frame data (object transforms, indirect commands, draw data).
+// With OpenGL 4.4 the storage is persistently mapped, each frame writes its own third of the buffer with
+// plain memcpy and a fence stops us from overwriting a third the GPU may still be reading.
+// Older contexts fall back to staging the frame on the CPU and uploading it with one glBufferSubData per Commit.
+class RingBuffer
+{
+public:
+	static const int Sections = 3; // Frames in flight
+
+	// Allocates Sections * sectionSize bytes, every Allocate is aligned to alignment
+	void Create(GLsizeiptr sectionSize, GLint alignment)
+	{
+		this->sectionSize = sectionSize; // Bytes available to one frame
+		this->alignment = alignment; // Offset alignment
+		persistent = GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage; // Immutable storage available
+		glGenBuffers(1, &ID); // Create buffer
+		glBindBuffer(GL_COPY_WRITE_BUFFER, ID); // Bind to a neutral target
+		if (persistent) // Map once for the lifetime of the buffer
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT; // Writes are visible without flushing
+			glBufferStorage(GL_COPY_WRITE_BUFFER, Sections * sectionSize, NULL, flags); // Immutable storage
+			mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, Sections * sectionSize, flags); // Persistent pointer
+		}
+		else
+		{
+			glBufferData(GL_COPY_WRITE_BUFFER, Sections * sectionSize, NULL, GL_STREAM_DRAW); // Mutable storage
+			staging.resize(Sections * sectionSize); // CPU copy written by Allocate
+			mapped = staging.data(); // Writes go to the staging copy
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0); // Unbind
+		for (int i = 0; i < Sections; i++) // No section is in use yet
+			fences[i] = 0;
+	}
+
+	// Waits until the GPU is done with this frame's section and rewinds the write head
+	void BeginFrame()
+	{
+		if (fences[section]) // Section was used Sections frames ago
+		{
+			GLenum result = glClientWaitSync(fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000); // Wait up to a second
+			if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED) // Should never happen with three sections
+				std::cout << "ERROR::RING_BUFFER:: fence wait failed" << std::endl; // Write error message
+			glDeleteSync(fences[section]); // Fence is done
+			fences[section] = 0; // Clear fence
+		}
+		head = section * sectionSize; // Start of this frame's section
+		committed = head; // Nothing staged yet
+	}
+
+	// Reserves size bytes for this frame and returns a pointer to fill, offset receives the buffer offset
+	void* Allocate(GLsizeiptr size, GLintptr& offset)
+	{
+		GLintptr aligned = (head + alignment - 1) / alignment * alignment; // Round head up
+		if (aligned + size > (section + 1) * sectionSize) // Does not fit in this frame's section
+		{
+			std::cout << "ERROR::RING_BUFFER:: frame section of " << sectionSize << " bytes is full" << std::endl; // Write error message
+			offset = -1; // Signal failure
+			return NULL;
+		}
+		offset = aligned; // Data starts here
+		head = aligned + size; // Advance head
+		return mapped + aligned; // Caller writes here
+	}
+
+	// Copies data into this frame's section, returns its buffer offset or -1 when the section is full
+	GLintptr Write(const void* data, GLsizeiptr size)
+	{
+		GLintptr offset; // Buffer offset
+		void* dst = Allocate(size, offset); // Reserve space
+		if (dst) // Space available
+			memcpy(dst, data, size); // Plain copy, no GL call
+		return offset;
+	}
+
+	// Makes everything written since the last Commit visible to the GPU
+	void Commit()
+	{
+		if (!persistent && head > committed) // Staged bytes waiting
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, ID); // Bind buffer
+			glBufferSubData(GL_COPY_WRITE_BUFFER, committed, head - committed, staging.data() + committed); // One upload for the whole range
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0); // Unbind
+			glCalls.bufferUploads++; // Count upload
+		}
+		committed = head; // Everything is visible now
+	}
+
+	// Fences this frame's section and moves to the next one, call after the frame's last draw
+	void EndFrame()
+	{
+		Commit(); // Anything still staged
+		fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); // Signals when the GPU has consumed the section
+		section = (section + 1) % Sections; // Next frame writes the next section
+	}
+
+	GLuint ID = 0; // Buffer handle
+	bool persistent = false; // True when glBufferStorage mapping is used
+
+private:
+	GLsizeiptr sectionSize = 0; // Bytes per frame
+	GLint alignment = 16; // Offset alignment
+	char* mapped = NULL; // Persistent mapping or staging copy
+	std::vector<char> staging; // CPU copy for the fallback path
+	GLsync fences[Sections]; // One fence per section
+	int section = 0; // Section written this frame
+	GLintptr head = 0; // Next free byte
+	GLintptr committed = 0; // Bytes already visible to the GPU
+};
+
+#endif
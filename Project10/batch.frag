@@ -0,0 +1,48 @@
+#version 460 core
+out vec4 FragColor; // Returns FragColor
+
+in vec3 Normal; // Receives Normal
+in vec3 FragPos; // Receives FragPos
+in vec2 TexCoord; // Receives TexCoord
+flat in uint Material; // Receives material index
+
+struct MaterialData {
+    vec4 color; // Material colour
+    uint textureLayer; // Layer of textures holding the material's texture
+};
+
+layout (std430, binding = 1) readonly buffer Materials {
+    MaterialData materials[]; // Every material in the batch
+};
+
+uniform vec3 lightPos; // Receives lightPos uniform
+uniform vec3 viewPos; // Receives viewPos uniform
+uniform vec3 lightColor; // Recieves lightColor uniform
+
+uniform sampler2DArray textures; // Material textures, one per layer. The material can change between the sub-draws of one multi draw, so it picks a layer, never a sampler
+
+void main()
+{
+    // ambient
+    float ambientStrength = 0.8;  // Set ambient strength
+    vec3 ambient = ambientStrength * lightColor;  // Sets ambient - multiplies strength decimal by light color
+
+    // diffuse
+    vec3 norm = normalize(Normal);  // Normalizes normal
+    vec3 lightDir = normalize(lightPos - FragPos);  // Sets light direction based on light - frag position
+    float diff = max(dot(norm, lightDir), 0.0);  // Diff value based on max method and dot product
+    vec3 diffuse = diff * lightColor;  // Sets diffuse
+
+    // specular
+    float specularStrength = 0.25f;  // Sets specular strength
+    vec3 viewDir = normalize(viewPos - FragPos);  // Sets view direction
+    vec3 reflectDir = reflect(-lightDir, norm);  // Sets reflect direction
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), 8);  // Sets specular based on power, max, and dot product
+    vec3 specular = specularStrength * spec * lightColor;  // Sets specular
+
+    //texture
+    vec3 texColor = texture(textures, vec3(TexCoord, float(materials[Material].textureLayer))).xyz; // Sample the material's layer
+    vec3 result = (ambient + diffuse + specular) * texColor;
+
+    FragColor = vec4(result, 1.0f);  // Sets vec4 based on result
+}
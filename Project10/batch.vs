@@ -0,0 +1,33 @@
+#version 460 core
+layout (location = 0) in vec3 aPos; // Receives aPos
+layout (location = 1) in vec3 aNormal; // Receives aNormal
+layout (location = 2) in vec2 aTexCoord; // Receives aTexCoord
+
+struct DrawData {
+    mat4 model; // World matrix
+    mat4 normalMatrix; // Inverse transpose of model, computed on the CPU
+    uint material; // Index into the material buffer
+};
+
+layout (std430, binding = 0) readonly buffer Draws {
+    DrawData draws[]; // One entry per indirect command, indexed by gl_DrawID
+};
+
+out vec3 FragPos; // Returns FragPos
+out vec3 Normal; // Returns Normal
+out vec2 TexCoord; // Returns TexCoord
+flat out uint Material; // Returns material index
+
+uniform mat4 view; // Receives view uniform
+uniform mat4 projection; // Receives projection uniform
+
+void main()
+{
+    DrawData draw = draws[gl_DrawID]; // Fetch this draw's data
+    vec4 worldPos = draw.model * vec4(aPos, 1.0); // World space position
+    gl_Position = projection * view * worldPos; // Implements transformations - multiplies transformation vectors
+    FragPos = vec3(worldPos); // Sets fragment position
+    Normal = mat3(draw.normalMatrix) * aNormal; // Transforms normal
+    TexCoord = aTexCoord; // Passes texture coordinates
+    Material = draw.material; // Passes material index
+}
@@ -7,14 +7,18 @@ out vec3 FragPos; // Returns FragPos
 out vec3 Normal; // Returns Normal
 out vec2 TexCoord;
 
-uniform mat4 model; // Receives model uniform
+layout (std140) uniform Object {
+    mat4 model; // World matrix, built once on the CPU
+    mat4 normalMatrix; // Inverse transpose of model, built once on the CPU
+};
 uniform mat4 view; // Receives view uniform
 uniform mat4 projection; // Receives projection uniform
 
 void main()
 {
-    gl_Position = projection * view * vec4(aPos, 1.0f);  // Implements transformations - multiplies transformation vectors
-    FragPos = vec3(model * vec4(aPos, 1.0));  // Sets fragment position
-    Normal = mat3(transpose(inverse(model))) * aNormal;  // Normalizes
+    vec4 worldPos = model * vec4(aPos, 1.0);  // World space position
+    gl_Position = projection * view * worldPos;  // Implements transformations - multiplies transformation vectors
+    FragPos = vec3(worldPos);  // Sets fragment position
+    Normal = mat3(normalMatrix) * aNormal;  // Transforms normal with the precomputed normal matrix
     TexCoord = aTexCoord;
 }
@@ -5,13 +5,16 @@ layout (location = 1) in vec3 aNormal;
 out vec3 Normal;
 out vec3 Position;
 
-uniform mat4 model;
+layout (std140) uniform Object {
+    mat4 model;
+    mat4 normalMatrix;
+};
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    Normal = mat3(normalMatrix) * aNormal;
     Position = vec3(model * vec4(aPos, 1.0));
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * vec4(Position, 1.0);
 }
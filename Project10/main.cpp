@@ -19,6 +19,13 @@
 #include "shader_m.h" // Include shader class
 #include "Camera.h" // Include Camera class
 #include "Model.h" // Include Model class
+#include "GLCallCounter.h" // Include per-frame GL call counter
+#include "RenderQueue.h" // Include state-sorted render queue
+#include "MeshBatch.h" // Include multi-draw indirect mesh batch
+#include "RingBuffer.h" // Include persistently mapped per-frame buffer
+
+#include <algorithm> // Include max
+#include <memory> // Include unique_ptr
 
 #define STB_IMAGE_IMPLEMENTATION
 #include  "stb_image.h"
@@ -42,6 +49,10 @@ glm::vec3 lightPos(1.0f, 1.0f, -2.0f); // Sets light position
 GLfloat deltaTime = 0.0f; // Initialize deltaTime for camera movement
 GLfloat lastFrame = 0.0f; // Initialize lastFrame for camera movement
 
+bool useIndirect = false; // Toggled with M, draws the models through the multi-draw indirect batch
+bool reportCalls = false; // Toggled with P, prints the per-frame GL call counter once a second
+GLfloat lastReport = 0.0f; // Time of the last call counter report
+
 int main() {
     // Init GLFW
     glfwInit(); // Initialize GLFW
@@ -69,8 +80,7 @@ int main() {
     // INSERT SHADERS HERE FOR PROJECT 10
     Shader checkerboardShader("checkerboard.vs", "checkerboard.frag"); // Create shader for checkerboard
     Shader cubeShader("cubemap.vs", "cubemap.fs"); // Create shader for cube object
-    Shader cylinderShader("bump.vs", "bump.frag"); // Create shader for cylinder object
-    Shader sphereShader("bump.vs", "bump.frag"); // Create shader for sphere object
+    Shader bumpShader("bump.vs", "bump.frag"); // Create shader shared by the cylinder and sphere objects
 
 
 
@@ -185,6 +195,9 @@ int main() {
     // Position attribute
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)0); // Set vertex attribute pointer for pos
     glEnableVertexAttribArray(0); // Enable vertex attrib array with 0
+    // Normal attribute, the last 3 floats of each vertex
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(5 * sizeof(GLfloat))); // Set vertex attrib pointer for normal
+    glEnableVertexAttribArray(1); // Enable with 1
     // TexCoord attribute
     glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(GLfloat), (GLvoid*)(3 * sizeof(GLfloat))); // Set vertex attrib pointer for texcoord
     glEnableVertexAttribArray(2); // Enable with 2
@@ -221,14 +234,81 @@ int main() {
     cubeShader.use(); // Activate cube shader
     cubeShader.setInt("skybox",0);
 
-    unsigned int cylinderTexture = loadTexture("Bump-Map.jpg");
-    cylinderShader.use();
+    unsigned int cylinderTexture = loadTexture("Bump-Map.jpg"); // Load cylinder texture
+    unsigned int sphereTexture = loadTexture("Bump-Picture.jpg"); // Load sphere texture
+
+    // The window is not resizable so the projection never changes, build it once up front
+    glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f); // Initialize projection using initial values
+
+    // Register programs and materials once, their uniform locations are cached by the queue
+    RenderQueue queue; // Initialize render queue
+    unsigned short checkerboardProgram = queue.AddProgram(checkerboardShader, "squareColor"); // Checkerboard program
+    unsigned short cubeProgram = queue.AddProgram(cubeShader, nullptr); // Reflective cube program
+    unsigned short bumpProgram = queue.AddProgram(bumpShader, "cylinderColor"); // Textured object program
+
+    unsigned short redTile = queue.AddMaterial({ glm::vec3(1.0f, 0.0f, 0.0f), GL_TEXTURE_2D, 0 }); // Red checkerboard tile
+    unsigned short whiteTile = queue.AddMaterial({ glm::vec3(1.0f, 1.0f, 1.0f), GL_TEXTURE_2D, 0 }); // White checkerboard tile
+    unsigned short cubeMaterial = queue.AddMaterial({ glm::vec3(1.0f), GL_TEXTURE_CUBE_MAP, cubemapTexture }); // Skybox reflection
+    unsigned short cylinderMaterial = queue.AddMaterial({ glm::vec3(0.0f, 1.0f, 0.0f), GL_TEXTURE_2D, cylinderTexture }); // Green bump mapped cylinder
+    unsigned short sphereMaterial = queue.AddMaterial({ glm::vec3(0.0f, 0.0f, 1.0f), GL_TEXTURE_2D, sphereTexture }); // Blue bump mapped sphere
+
+    // Object placements never change, build their model and normal matrices once
+    ObjectTransform tileTransforms[64]; // One transform per checkerboard tile
+    for (int i = 0; i < 8; i++) { // For 8 rows
+        for (int j = 0; j < 8; j++) { // For 8 columns
+            glm::mat4 tile = glm::translate(glm::mat4(1.0f), glm::vec3(j-4.0f, -0.5f, i-9.0f)); // Translate square to posiiton [setting x and z for grid]
+            tileTransforms[i * 8 + j] = ObjectTransform(glm::scale(tile, glm::vec3(1.0f, 0.1f, 1.0f))); // Scale squares to be like tiles
+        }
+    }
+    ObjectTransform cubeTransform(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -5.0f))); // Translate cube back
+    glm::mat4 cylinderModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(1.2f, -3.0f, -5.5f)); // Translate cylinder back, to the right, and down
+    ObjectTransform cylinderTransform(glm::scale(cylinderModelMatrix, glm::vec3(0.5, 3.0, 0.5))); // Increase height of cylinder
+    glm::mat4 sphereModelMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(-1.2f, 0.0f, -5.0f)); // Translate sphere back and to the left
+    ObjectTransform sphereTransform(glm::scale(sphereModelMatrix, glm::vec3(0.5f, 0.5f, 0.5f))); // Scale down sphere
+
+    // Models drawn through one glMultiDrawElementsIndirect call when the context supports it
+    MeshBatch batch; // Initialize mesh batch
+    std::unique_ptr<Shader> batchShader; // Only compiled when supported
+    GLint batchViewLoc = -1, batchViewPosLoc = -1, batchLightPosLoc = -1; // Cached batch uniform locations
+    unsigned int cylinderBatchModel = 0, sphereBatchModel = 0; // Batch model indices
+    unsigned int cylinderBatchMaterial = 0, sphereBatchMaterial = 0; // Batch material indices
+    if (MeshBatch::Supported()) { // OpenGL 4.6 available
+        cylinderBatchModel = batch.AddModel(cylinderModel); // Add cylinder meshes
+        sphereBatchModel = batch.AddModel(sphereModel); // Add sphere meshes
+        cylinderBatchMaterial = batch.AddMaterial(glm::vec3(0.0f, 1.0f, 0.0f), cylinderTexture); // Cylinder material
+        sphereBatchMaterial = batch.AddMaterial(glm::vec3(0.0f, 0.0f, 1.0f), sphereTexture); // Sphere material
+        batch.Upload(); // Create shared buffers
+
+        batchShader.reset(new Shader("batch.vs", "batch.frag")); // Create batch shader
+        batchShader->use(); // Activate batch shader
+        batch.BindSamplers(batchShader->ID); // Point the texture array sampler at unit 0
+        batchShader->setMat4("projection", projection); // Projection never changes
+        batchShader->setVec3("lightColor", 1.0f, 1.0f, 1.0f); // White light
+        batchViewLoc = glGetUniformLocation(batchShader->ID, "view"); // Cache view location
+        batchViewPosLoc = glGetUniformLocation(batchShader->ID, "viewPos"); // Cache viewPos location
+        batchLightPosLoc = glGetUniformLocation(batchShader->ID, "lightPos"); // Cache lightPos location
+        useIndirect = true; // Default to the indirect path
+    } else {
+        std::cout << "OpenGL 4.6 not available, drawing models one mesh at a time" << std::endl; // Fallback notice
+    }
+
+    // Per-frame data (object matrices, indirect commands, draw data) is written into a triple buffered ring
+    GLint uniformAlignment = 16, storageAlignment = 16; // Offset alignment required by the bindings that read the ring
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment); // Object blocks are bound as uniform buffers
+    if (MeshBatch::Supported()) // Draw data is bound as a storage buffer
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment); // Query storage alignment
+    RingBuffer ring; // Initialize ring buffer
+    ring.Create(256 * 1024, std::max(uniformAlignment, storageAlignment)); // 256 KB per frame in flight
+    if (!ring.persistent) // No glBufferStorage
+        std::cout << "OpenGL 4.4 not available, per-frame data is uploaded with one glBufferSubData per batch" << std::endl; // Fallback notice
 
-    unsigned int sphereTexture = loadTexture("Bump-Picture.jpg");
-    sphereShader.use();
+    unsigned int frameNumber = 0; // Counts frames so the queue uploads per-frame uniforms once per program
 
     // Game Loop
     while (!glfwWindowShouldClose(window)) {
+        glCalls.Reset(); // Start counting GL calls for this frame
+        ring.BeginFrame(); // Wait for this frame's ring section to be free
+
         // Calculate deltaTime for camera movement
         GLfloat currentFrame = glfwGetTime(); // Get current time
         deltaTime = currentFrame - lastFrame; // Calculate change in time
@@ -241,137 +321,62 @@ int main() {
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // Set background color
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // Clear buffers
 
-        
-        // Initialize Camera
-        glm::mat4 view = glm::mat4(1.0f); // Initialize view to identity
-        view = camera.GetViewMatrix(); // Set view based on camera
-        glm::mat4 projection = glm::perspective(45.0f, (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f); // Initialize projection using initial values
-        glm::mat4 model = glm::mat4(1.0f); // Initialize model to be 4x4 identity
-
-        // BIND TEXTURES HERE PROJECT 10
+        // Values shared by every object this frame, the view is built once and handed to the queue
+        FrameUniforms frame; // Initialize frame uniforms
+        frame.view = camera.GetViewMatrix(); // Set view based on camera
+        glCalls.matrixBuilds++; // Count view rebuild
+        frame.projection = projection; // Set projection
+        frame.lightPos = lightPos; // Set light position
+        frame.lightColor = glm::vec3(1.0f, 1.0f, 1.0f); // White light
+        frame.viewPos = camera.Position; // Set camera position
+        frame.frame = frameNumber++; // Set frame number
 
         // CHECKERBOARD
-        checkerboardShader.use(); // Use checkerboard shader
-
-        GLint squareColorLoc = glGetUniformLocation(checkerboardShader.ID, "squareColor"); // Retrieve uniform location for squareColor
-        GLint lightColorLoc = glGetUniformLocation(checkerboardShader.ID, "lightColor"); // Retrieve uniform location for lightColor
-        GLint lightPosLoc = glGetUniformLocation(checkerboardShader.ID, "lightPos"); // Retrieve uniform location for lightPos
-        GLint viewPosLoc = glGetUniformLocation(checkerboardShader.ID, "viewPos"); // Retrieve uniform location for viewPos
-
-        glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f); // Pass white color to lightColorLoc uniform
-        glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z); // Pass light position to lightPosLoc uniform
-        glUniform3f(viewPosLoc, camera.Position.x, camera.Position.y, camera.Position.z); // Pass camera position to viewPosLoc uniform
-
-        glm::mat4 view_square = view; // Create mat4 view_square equal to view generic defined above
-
-        GLint modelLoc = glGetUniformLocation(checkerboardShader.ID, "model"); // Retrieve model uniform location
-        GLint viewLoc = glGetUniformLocation(checkerboardShader.ID, "view"); // Retrieve view uniform location
-        GLint projLoc = glGetUniformLocation(checkerboardShader.ID, "projection"); // Retrieve projection uniform location
-
         for (int i = 0; i < 8; i++) { // For 8 rows
             for (int j = 0; j < 8; j++) { // For 8 columns
-                if ((i+j) % 2 == 0) { // Check if i+j is odd or even for color purposes
-                    glUniform3f(squareColorLoc, 1.0f, 0.0f, 0.0f); // If even square color is purple --> pass purple to uniform
-                } else {
-                    glUniform3f(squareColorLoc, 1.0f, 1.0f, 1.0f); // If even square color is white --> pas white to uniform
-                }
-                view_square = glm::translate(view_square, glm::vec3(j-4.0f, -0.5f, i-9.0f)); // Translate square to posiiton [setting x and z for grid]
-                view_square = glm::scale(view_square, glm::vec3(1.0f, 0.1f, 1.0f)); // Scale squares to be like tiles
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); // Pass model to uniform
-                glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view_square)); // Pass view_square to uniform
-                glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection)); // Pass projection to uniform
-                // Draw square
-                glBindVertexArray(VAO); // Bind vertex arrays
-                glDrawArrays(GL_TRIANGLES, 0, 36); // Draw arrays for cube
-                view_square = view; // Reset view_square to original view identity [i.e. Translations are independent]
-                
+                unsigned short tileMaterial = ((i+j) % 2 == 0) ? redTile : whiteTile; // Check if i+j is odd or even for color purposes
+                queue.Submit(checkerboardProgram, tileMaterial, VAO, 36, false, tileTransforms[i * 8 + j]); // Queue square
             }
         }
-        glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);  // Bind VBO
-        glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices, GL_STATIC_DRAW);  // Buffer Data
+
         // CUBE
-        cubeShader.use(); // Activate cube shader
-
-        model = glm::mat4(1.0f);
-        view = camera.GetViewMatrix();
-        projection = glm::perspective(45.0f, (GLfloat)WIDTH / (GLfloat)HEIGHT, 0.1f, 100.0f);
-        cubeShader.setMat4("model", model);
-        cubeShader.setMat4("view", view);
-        cubeShader.setMat4("projection", projection);
-
-        glm::mat4 view_cube = view; // Create mat4 view_cube equal to identity view
-        view_cube = glm::translate(view_cube, glm::vec3(0.0f, 0.0f, -5.0f)); // Translate cube back
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view_cube)); // Pass view_cube to shader
-
-        // Draw cube
-        glBindVertexArray(cubeVAO); // Bind vertex arrays
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36); // Draw cube
-        glBindVertexArray(0);
-
-        
-        // CYLINDER
-        cylinderShader.use(); // Activate cylinder shader
-
-        GLint cylinderColorLoc = glGetUniformLocation(cylinderShader.ID, "cylinderColor"); // Retrieve cylinderColor location
-        lightColorLoc = glGetUniformLocation(cylinderShader.ID, "lightColor"); // Reset lightColor location
-        lightPosLoc = glGetUniformLocation(cylinderShader.ID, "lightPos"); // Reset lightPos location
-        viewPosLoc = glGetUniformLocation(cylinderShader.ID, "viewPos"); // Reset viewPos location
-
-        glUniform3f(cylinderColorLoc, 0.0f, 1.0f, 0.0f); // Pass color to uniform
-        glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f); // Pass light color to uniform
-        glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z); // Pass light position to uniform
-        glUniform3f(viewPosLoc, camera.Position.x, camera.Position.y, camera.Position.z); // Pass camera position to uniform
-
-        modelLoc = glGetUniformLocation(cylinderShader.ID, "model"); // Reset view location for cylinderShader
-        viewLoc = glGetUniformLocation(cylinderShader.ID, "view"); // Reset view location for cylinderShader
-        projLoc = glGetUniformLocation(cylinderShader.ID, "projection"); // Reset view location for cylinderShader
-
-        glm::mat4 view_cylinder = view; // Create mat4 view_cylinder using generic view identity
-        view_cylinder = glm::translate(view_cylinder, glm::vec3(1.2f, -3.0f, -5.5f)); // Translate cylinder back, to the right, and down
-        view_cylinder = glm::scale(view_cylinder, glm::vec3(0.5, 3.0, 0.5)); // Increase height of cylinder
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view_cylinder)); // Pass view_cylinder to shader
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection)); // Pass projection to shader
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); // Pass moel to shader
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cylinderTexture);
-        cylinderModel.Draw(cylinderShader); // Draw obj model
-
-        // SPHERE
-        sphereShader.use(); // Activate sphereShader
-
-        GLint sphereColorLoc = glGetUniformLocation(sphereShader.ID, "sphereColor"); // Retrieve sphereColor location
-        lightColorLoc = glGetUniformLocation(sphereShader.ID, "lightColor"); // Reset lightColor location for sphereShader
-        lightPosLoc = glGetUniformLocation(sphereShader.ID, "lightPos"); // Reset lightPos location for sphereShader
-        viewPosLoc = glGetUniformLocation(sphereShader.ID, "viewPos"); // Reset viewPos location for sphereShader
-
-        glUniform3f(sphereColorLoc, 0.0f, 0.0f, 1.0f); // Pass in sphere color to uniform
-        glUniform3f(lightColorLoc, 1.0f, 1.0f, 1.0f); // Pass in light color to uniform
-        glUniform3f(lightPosLoc, lightPos.x, lightPos.y, lightPos.z); // Pass in light position to uniform
-        glUniform3f(viewPosLoc, camera.Position.x, camera.Position.y, camera.Position.z); // Pass in camera position to uniform
-
-        modelLoc = glGetUniformLocation(sphereShader.ID, "model"); // Reset model uniform location for sphereShader
-        viewLoc = glGetUniformLocation(sphereShader.ID, "view"); // Reset view uniform location for sphereShader
-        projLoc = glGetUniformLocation(sphereShader.ID, "projection"); // Reset projection uniform location for sphereShader
-
-        glm::mat4 view_sphere = view; // Create mat4 view_sphere equal to view identity
-        view_sphere = glm::translate(view_sphere, glm::vec3(-1.2f, 0.0f, -5.0f)); // Translate sphere back and to the left
-        view_sphere = glm::scale(view_sphere, glm::vec3(0.5f, 0.5f, 0.5f)); // Scale down sphere
-
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view_sphere)); // Pass view_sphere to uniform
-        glUniformMatrix4fv(projLoc, 1, GL_FALSE, glm::value_ptr(projection)); // Pass projection to uniform
-        glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model)); // Pass model to uniform
-
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sphereTexture);
-        sphereModel.Draw(sphereShader); // Draw sphere obj model
+        queue.Submit(cubeProgram, cubeMaterial, cubeVAO, 36, false, cubeTransform); // Queue cube
+
+        if (!useIndirect) { // Models go through the queue one mesh at a time
+            // CYLINDER
+            queue.SubmitModel(bumpProgram, cylinderMaterial, cylinderModel, cylinderTransform); // Queue cylinder meshes
+
+            // SPHERE
+            queue.SubmitModel(bumpProgram, sphereMaterial, sphereModel, sphereTransform); // Queue sphere meshes
+        }
+
+        queue.Flush(frame, ring); // Sort by state and draw everything in one pass
+
+        if (useIndirect) { // Every visible model mesh in one call
+            batch.Begin(projection * frame.view); // Start batch with this frame's frustum
+            batch.Add(cylinderBatchModel, cylinderBatchMaterial, cylinderTransform); // CYLINDER
+            batch.Add(sphereBatchModel, sphereBatchMaterial, sphereTransform); // SPHERE
+            glCalls.UseProgram(batchShader->ID); // Activate batch shader
+            glUniformMatrix4fv(batchViewLoc, 1, GL_FALSE, glm::value_ptr(frame.view)); // Pass view to uniform
+            glUniform3fv(batchViewPosLoc, 1, glm::value_ptr(frame.viewPos)); // Pass camera position to uniform
+            glUniform3fv(batchLightPosLoc, 1, glm::value_ptr(frame.lightPos)); // Pass light position to uniform
+            batch.Draw(ring); // Submit with glMultiDrawElementsIndirect
+        }
 
         glBindVertexArray(0); // Bind zero at end
+        ring.EndFrame(); // Fence this frame's ring section
         glfwSwapBuffers(window); // Swap screen buffers
 
+        if (reportCalls && currentFrame - lastReport >= 1.0f) { // Report at most once a second
+            glCalls.Print(); // Print this frame's GL call counts
+            std::cout << "Render queue: program switches " << queue.programSwitches // Print program switches
+                << ", texture switches " << queue.textureSwitches // Print texture switches
+                << ", VAO switches " << queue.vaoSwitches << std::endl; // Print VAO switches
+            if (useIndirect) // Indirect path active
+                std::cout << "Mesh batch: " << batch.DrawCount() << " meshes in one call, " << batch.CulledCount() << " culled" << std::endl; // Print batch counts
+            lastReport = currentFrame; // Remember report time
+        }
+
 
     }
     // Deallocate resources
@@ -454,6 +459,10 @@ unsigned int loadCubemap(vector<std::string> faces)
 void key_callback(GLFWwindow* window, int key, int scancode, int action, int mode) {
     if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) { // If ESC pressed
         glfwSetWindowShouldClose(window, GL_TRUE); // Close window
+    } if (key == GLFW_KEY_M && action == GLFW_PRESS && MeshBatch::Supported()) { // If M pressed and indirect drawing is available
+        useIndirect = !useIndirect; // Toggle multi-draw indirect path
+    } if (key == GLFW_KEY_P && action == GLFW_PRESS) { // If P pressed
+        reportCalls = !reportCalls; // Toggle GL call counter report
     } if (key >= 0 && key < 1024) { // Allow for 1024 key presses
         if (action == GLFW_PRESS) { // If pressed
             keys[key] = true; // Set keys[key] = true [key pressed]
@@ -4,6 +4,10 @@
 // This program is for project4 where we will be modeling the given
 // scene (my livingroom).
 //
+// The room never changes, so it is built once into an interleaved
+// vertex and index buffer with a color for every face, and each frame
+// is one draw call under the rotation.
+//
 // Interaction:
 // Use w,a,s,d to rotate the screne.
 // Press r to reset.
@@ -11,11 +15,15 @@
 // COMPILE: g++ -o Livingroom Livingroom.cpp -lGLEW -lGL -lGLU -lglut
 //
 // RUN: ./Livingroom
+// BENCHMARK: ./Livingroom --benchmark
 //
 // Jonathon Moore.
 ///////////////////////////////////////////////////////////////
 
 #include <iostream>
+#include <chrono>
+#include <cstring>
+#include <vector>
 
 #include <GL/glew.h>
 #include <GL/freeglut.h>
@@ -23,404 +31,320 @@
 
 #define PI 3.14159265358979323846
 
+// One vertex of the room, position then color
+struct RoomVertex {
+    GLfloat x, y, z;
+    GLfloat r, g, b;
+};
+
+// How a part is turned before it is moved into place, the glRotatef each part used to be drawn with
+enum Turn {
+    Unturned,
+    Turn90AboutX,
+    Turn90AboutY,
+    Turn270AboutX
+};
+
 // Globals
 static float HorizontalAngle = 340.0; // Horizontal rotation angle (left/right)
 static float VerticalAngle = 20.0;   // Vertical rotation angle (up/down)
+static std::vector<RoomVertex> roomVertices;  // The whole room, built once by buildRoom
+static std::vector<GLuint> roomIndices;       // Three per triangle
+static GLuint roomBuffers[2];                 // Vertex and index buffer objects
+static GLsizei roomIndexCount = 0;
+
+
+// Function to add a vertex at (x, y, z) turned by turn and then moved to (ox, oy, oz), returns its index
+GLuint addVertex(Turn turn, GLfloat ox, GLfloat oy, GLfloat oz, GLfloat x, GLfloat y, GLfloat z, const GLfloat color[3]) {
+    GLfloat p[3] = { x, y, z };
+    if (turn == Turn90AboutX) {
+        p[1] = -z;
+        p[2] = y;
+    }
+    else if (turn == Turn90AboutY) {
+        p[0] = z;
+        p[2] = -x;
+    }
+    else if (turn == Turn270AboutX) {
+        p[1] = z;
+        p[2] = -y;
+    }
+    roomVertices.push_back({ ox + p[0], oy + p[1], oz + p[2], color[0], color[1], color[2] });
+    return (GLuint)roomVertices.size() - 1;
+}
 
+// Function to add the triangle a, b, c
+void addTriangle(GLuint a, GLuint b, GLuint c) {
+    roomIndices.push_back(a);
+    roomIndices.push_back(b);
+    roomIndices.push_back(c);
+}
 
-// Function to create a rectangular prism with given dimensions and position
-void drawRectangularPrism(GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height, GLfloat depth) {
-    // Enable depth
-    glEnable(GL_DEPTH_TEST);
 
+// Function to add a rectangular prism with given dimensions and position, every face its own color
+void addRectangularPrism(GLfloat x, GLfloat y, GLfloat z, GLfloat width, GLfloat height, GLfloat depth) {
     // Calculate half dimensions for centering the prism at (x, y, z)
     GLfloat halfWidth = width / 2.0f;
     GLfloat halfHeight = height / 2.0f;
     GLfloat halfDepth = depth / 2.0f;
 
-    glBegin(GL_QUADS);  // Start drawing the prism using quads
-
-    // Front face
-    glColor3f(0.0, 0.0, 1.0);
-    glVertex3f(x - halfWidth, y - halfHeight, z + halfDepth);
-    glVertex3f(x + halfWidth, y - halfHeight, z + halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z + halfDepth);
-    glVertex3f(x - halfWidth, y + halfHeight, z + halfDepth);
-
-    // Back face
-    glColor3f(0.0, 1.0, 1.0);
-    glVertex3f(x - halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z - halfDepth);
-    glVertex3f(x - halfWidth, y + halfHeight, z - halfDepth);
-
-    // Top face
-    glColor3f(1.0, 0.0, 1.0);
-    glVertex3f(x - halfWidth, y + halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z + halfDepth);
-    glVertex3f(x - halfWidth, y + halfHeight, z + halfDepth);
-
-    // Bottom face
-    glColor3f(0.0, 0.5, 1.0);
-    glVertex3f(x - halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y - halfHeight, z + halfDepth);
-    glVertex3f(x - halfWidth, y - halfHeight, z + halfDepth);
-
-    // Right face
-    glColor3f(0.5, 0.0, 1.0);
-    glVertex3f(x + halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x + halfWidth, y - halfHeight, z + halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z + halfDepth);
-    glVertex3f(x + halfWidth, y + halfHeight, z - halfDepth);
-
-    // Left face
-    glColor3f(1.0, 1.0, 0.0);
-    glVertex3f(x - halfWidth, y - halfHeight, z - halfDepth);
-    glVertex3f(x - halfWidth, y - halfHeight, z + halfDepth);
-    glVertex3f(x - halfWidth, y + halfHeight, z + halfDepth);
-    glVertex3f(x - halfWidth, y + halfHeight, z - halfDepth);
-
-    glEnd();  // End drawing the prism
-    glDisable(GL_DEPTH_TEST);   // Disable depth drawing
-}
-
-
-// Function to draw a cylinder at a specified position
-void drawStraightCylinder(float x, float y, float z, float radius, float height, int slices) {
-    glPushMatrix(); // Save the current transformation matrix
-
-    // Move the cylinder to its designated location
-    glTranslatef(x, y, z);
-
-    // Enable depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Top circle
-    // Set the color
-    glColor3f(0.0, 0.0, 1.0);
-    glPushMatrix();
-    glTranslatef(0.0, 0.0, height);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glEnd();
-    glPopMatrix();
-
-    // Bottom circle
-    glColor3f(0.0, 1.0, 1.0);
-    glPushMatrix();
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glEnd();
-    glPopMatrix();
-
-    // Cylinder's side
-    glColor3f(1.0, 1.0, 0.0);
-    glBegin(GL_QUAD_STRIP);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, height);
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
+    // Corners of each face as -1 or +1 of the half dimensions, in the order the quads were drawn
+    static const GLfloat faces[6][4][3] = {
+        { { -1, -1, 1 }, { 1, -1, 1 }, { 1, 1, 1 }, { -1, 1, 1 } },         // Front face
+        { { -1, -1, -1 }, { 1, -1, -1 }, { 1, 1, -1 }, { -1, 1, -1 } },     // Back face
+        { { -1, 1, -1 }, { 1, 1, -1 }, { 1, 1, 1 }, { -1, 1, 1 } },         // Top face
+        { { -1, -1, -1 }, { 1, -1, -1 }, { 1, -1, 1 }, { -1, -1, 1 } },     // Bottom face
+        { { 1, -1, -1 }, { 1, -1, 1 }, { 1, 1, 1 }, { 1, 1, -1 } },         // Right face
+        { { -1, -1, -1 }, { -1, -1, 1 }, { -1, 1, 1 }, { -1, 1, -1 } }      // Left face
+    };
+    static const GLfloat colors[6][3] = {
+        { 0.0, 0.0, 1.0 }, { 0.0, 1.0, 1.0 }, { 1.0, 0.0, 1.0 }, { 0.0, 0.5, 1.0 }, { 0.5, 0.0, 1.0 }, { 1.0, 1.0, 0.0 }
+    };
+
+    for (int f = 0; f < 6; f++) {
+        GLuint corner[4];
+        for (int c = 0; c < 4; c++) {
+            corner[c] = addVertex(Unturned, x, y, z, faces[f][c][0] * halfWidth, faces[f][c][1] * halfHeight, faces[f][c][2] * halfDepth, colors[f]);
+        }
+        addTriangle(corner[0], corner[1], corner[2]);
+        addTriangle(corner[0], corner[2], corner[3]);
     }
-    glDisable(GL_DEPTH_TEST);   // Disable depth drawing
-    glEnd();
-
-    glPopMatrix(); // Restore the original transformation matrix
-
 }
 
 
-// Function to draw a cylinder at a specified position
-void drawHorizontalCylinder(float x, float y, float z, float radius, float height, int slices) {
-    glPushMatrix(); // Save the current transformation matrix
-
-    // Move the cylinder to its designated location
-    glTranslatef(x, y, z);
-
-    // Rotate the cylinder to make it horizontal (90 degrees around the x-axis)
-    glRotatef(90, 0.0, 1.0, 0.0);
-
-    // Enable depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Top circle
-    // Set the color
-    glColor3f(0.5, 0.0, 1.0);
-    glPushMatrix();
-    glTranslatef(0.0, 0.0, height);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glEnd();
-    glPopMatrix();
-
-    // Bottom circle
-    glColor3f(1.0, 1.0, 0.0);
-    glPushMatrix();
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
+// Function to add a cylinder along the z axis from 0 to height, turned by turn and moved to (x, y, z)
+void addCylinder(Turn turn, float x, float y, float z, float radius, float height, int slices,
+    const GLfloat top[3], const GLfloat bottom[3], const GLfloat side[3]) {
+    // Top and bottom circles as fans around their centers
+    for (int end = 0; end < 2; end++) {
+        float level = end == 0 ? height : 0.0f;
+        const GLfloat* color = end == 0 ? top : bottom;
+        GLuint center = addVertex(turn, x, y, z, 0.0, 0.0, level, color);
+        for (int i = 0; i <= slices; i++) {
+            float angle = 2 * PI * i / slices;
+            GLuint rim = addVertex(turn, x, y, z, cos(angle) * radius, sin(angle) * radius, level, color);
+            if (i > 0) addTriangle(center, rim - 1, rim);
+        }
     }
-    glEnd();
-    glPopMatrix();
 
-    // Cylinder's side
-    glColor3f(0.0, 0.0, 1.0);
-    glBegin(GL_QUAD_STRIP);
+    // Cylinder's side, a quad between each pair of slices
     for (int i = 0; i <= slices; i++) {
         float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, height);
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
+        GLuint upper = addVertex(turn, x, y, z, cos(angle) * radius, sin(angle) * radius, height, side);
+        addVertex(turn, x, y, z, cos(angle) * radius, sin(angle) * radius, 0.0, side);
+        if (i > 0) {
+            addTriangle(upper - 2, upper - 1, upper + 1);
+            addTriangle(upper - 2, upper + 1, upper);
+        }
     }
-    glDisable(GL_DEPTH_TEST);   // Disable depth drawing
-    glEnd();
-
-    glPopMatrix(); // Restore the original transformation matrix
-
 }
 
-
-// Function to draw a cylinder at a specified position
-void drawVerticalCylinder(float x, float y, float z, float radius, float height, int slices) {
-    glPushMatrix(); // Save the current transformation matrix
-
-    // Move the cylinder to its designated location
-    glTranslatef(x, y, z);
-
-    // Rotate the cylinder to make it horizontal (90 degrees around the x-axis)
-    glRotatef(90, 1.0, 0.0, 0.0);
-
-    // Enable depth
-    glEnable(GL_DEPTH_TEST);
-
-    // Top circle
-    // Set the color
-    glColor3f(0.5, 0.0, 1.0);
-    glPushMatrix();
-    glTranslatef(0.0, 0.0, height);
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glEnd();
-    glPopMatrix();
-
-    // Bottom circle
-    glColor3f(1.0, 1.0, 0.0);
-    glPushMatrix();
-    glBegin(GL_TRIANGLE_FAN);
-    glVertex3f(0.0, 0.0, 0.0);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glEnd();
-    glPopMatrix();
-
-    // Cylinder's side
-    glColor3f(0.0, 0.0, 1.0);
-    glBegin(GL_QUAD_STRIP);
-    for (int i = 0; i <= slices; i++) {
-        float angle = 2 * PI * i / slices;
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, height);
-        glVertex3f(cos(angle) * radius, sin(angle) * radius, 0.0);
-    }
-    glDisable(GL_DEPTH_TEST);   // Disable depth drawing
-    glEnd();
-
-    glPopMatrix(); // Restore the original transformation matrix
-
+// Function to add a cylinder standing on its end at a specified position
+void addStraightCylinder(float x, float y, float z, float radius, float height, int slices) {
+    static const GLfloat top[3] = { 0.0, 0.0, 1.0 }, bottom[3] = { 0.0, 1.0, 1.0 }, side[3] = { 1.0, 1.0, 0.0 };
+    addCylinder(Unturned, x, y, z, radius, height, slices, top, bottom, side);
 }
 
+// Function to add a cylinder lying along the x axis at a specified position
+void addHorizontalCylinder(float x, float y, float z, float radius, float height, int slices) {
+    static const GLfloat top[3] = { 0.5, 0.0, 1.0 }, bottom[3] = { 1.0, 1.0, 0.0 }, side[3] = { 0.0, 0.0, 1.0 };
+    addCylinder(Turn90AboutY, x, y, z, radius, height, slices, top, bottom, side);
+}
 
-void drawHemisphere(float x, float y, float z, float radius, int slices, int stacks) {
-    // Enable depth
-    glEnable(GL_DEPTH_TEST);
-
-    glPushMatrix();
-    glTranslatef(x, y, z);  // Move the sphere to the desired location
+// Function to add a cylinder hanging down from a specified position
+void addVerticalCylinder(float x, float y, float z, float radius, float height, int slices) {
+    static const GLfloat top[3] = { 0.5, 0.0, 1.0 }, bottom[3] = { 1.0, 1.0, 0.0 }, side[3] = { 0.0, 0.0, 1.0 };
+    addCylinder(Turn90AboutX, x, y, z, radius, height, slices, top, bottom, side);
+}
 
-    // Rotate to make the flat part on top
-    glRotatef(270.0, 1.0, 0.0, 0.0);
 
-    for (int i = 0; i < stacks / 2; i++) { // Iterate only over half the stacks for a hemisphere
-        float lat0 = PI * (-0.5 + (float) i / stacks);
-        float z0  = sin(lat0);
-        float zr0 = cos(lat0);
+// Function to add a hemisphere with its flat side up at a specified position
+void addHemisphere(float x, float y, float z, float radius, int slices, int stacks) {
+    static const GLfloat color[3] = { 0.0, 0.0, 1.0 };
 
-        float lat1 = PI * (-0.5 + (float) (i+1) / stacks);
-        float z1 = sin(lat1);
-        float zr1 = cos(lat1);
+    // Rings of slices + 1 points from the bottom up to the rim, each shared by the bands above and below it
+    GLuint first = (GLuint)roomVertices.size();
+    for (int i = 0; i <= stacks / 2; i++) { // Iterate only over half the stacks for a hemisphere
+        float lat = PI * (-0.5 + (float) i / stacks);
+        float rz = sin(lat);
+        float rr = cos(lat);
 
-        glBegin(GL_TRIANGLE_STRIP);
         for (int j = 0; j <= slices; j++) {
             float lng = 2 * PI * (float) j / slices;
-            float x = cos(lng);
-            float y = sin(lng);
-
-            glColor3f(0.0, 0.0, 1.0); // Color can be adjusted or made a parameter
-            glNormal3f(x * zr0, y * zr0, z0);
-            glVertex3f(x * zr0 * radius, y * zr0 * radius, z0 * radius);
-            glNormal3f(x * zr1, y * zr1, z1);
-            glVertex3f(x * zr1 * radius, y * zr1 * radius, z1 * radius);
+            addVertex(Turn270AboutX, x, y, z, cos(lng) * rr * radius, sin(lng) * rr * radius, rz * radius, color);
         }
-        glEnd();
     }
 
-    glPopMatrix();
-    glDisable(GL_DEPTH_TEST);
+    // A band of triangles between each pair of rings, as the triangle strips it used to be drawn with
+    for (int i = 0; i < stacks / 2; i++) {
+        GLuint lower = first + i * (slices + 1), upper = lower + slices + 1;
+        for (int j = 1; j <= slices; j++) {
+            addTriangle(lower + j - 1, upper + j - 1, lower + j);
+            addTriangle(upper + j - 1, lower + j, upper + j);
+        }
+    }
 }
 
 
-// Drawing routine
-void drawScene(void)
+// Builds the whole room into roomVertices and roomIndices, in the order it used to be drawn
+void buildRoom(void)
 {
-    // Clear the scene
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    roomVertices.clear();
+    roomIndices.clear();
 
     // Draw the TV
     float TV_X = 20.0;
     float TV_Y = 37.5;
     float TV_Z = -52.5;
-    drawRectangularPrism(TV_X, TV_Y, TV_Z, 60.0, 25.0, 5.0); // Screen
-    drawRectangularPrism(TV_X + 10, TV_Y - 15, TV_Z, 2.0, 5.0, 2.0); // Left leg
-    drawRectangularPrism(TV_X - 10, TV_Y - 15, TV_Z, 2.0, 5.0, 2.0); // Right leg
+    addRectangularPrism(TV_X, TV_Y, TV_Z, 60.0, 25.0, 5.0); // Screen
+    addRectangularPrism(TV_X + 10, TV_Y - 15, TV_Z, 2.0, 5.0, 2.0); // Left leg
+    addRectangularPrism(TV_X - 10, TV_Y - 15, TV_Z, 2.0, 5.0, 2.0); // Right leg
 
     // Draw the entertainment center
     float EC_X = 10.0;
     float EC_Y = 19.0;
     float EC_Z = -50.0;
 
-    drawRectangularPrism(EC_X, EC_Y, EC_Z, 80.0, 3.0, 20.0); // top plate
-    drawRectangularPrism(EC_X, EC_Y - 25, EC_Z, 80.0, 3.0, 20.0); // bottom plate
-    drawRectangularPrism(EC_X, EC_Y - 12.5, EC_Z - 10, 80.0, 28.0, 3.0); // back plate
-    drawRectangularPrism(EC_X - 30, EC_Y - 12.5, EC_Z, 20.0, 25.0, 20.0); // left cupboard
-    drawRectangularPrism(EC_X + 30, EC_Y - 12.5, EC_Z, 20.0, 25.0, 20.0); // left cupboard
-    drawRectangularPrism(EC_X, EC_Y - 12.5, EC_Z, 80.0, 3.0, 20.0); // middle plate
+    addRectangularPrism(EC_X, EC_Y, EC_Z, 80.0, 3.0, 20.0); // top plate
+    addRectangularPrism(EC_X, EC_Y - 25, EC_Z, 80.0, 3.0, 20.0); // bottom plate
+    addRectangularPrism(EC_X, EC_Y - 12.5, EC_Z - 10, 80.0, 28.0, 3.0); // back plate
+    addRectangularPrism(EC_X - 30, EC_Y - 12.5, EC_Z, 20.0, 25.0, 20.0); // left cupboard
+    addRectangularPrism(EC_X + 30, EC_Y - 12.5, EC_Z, 20.0, 25.0, 20.0); // left cupboard
+    addRectangularPrism(EC_X, EC_Y - 12.5, EC_Z, 80.0, 3.0, 20.0); // middle plate
 
     // Draw the coffee table
     float CT_X = 10.0;
     float CT_Y = 9.0;
     float CT_Z = 5.0;
 
-    drawRectangularPrism(CT_X, CT_Y, CT_Z, 70.0, 7.0, 30.0); // top plate
-    drawRectangularPrism(CT_X - 32.5, CT_Y - 6.5, CT_Z + 12.5, 5.0, 20.0, 5.0); // front left leg
-    drawRectangularPrism(CT_X + 32.5, CT_Y - 6.5, CT_Z + 12.5, 5.0, 20.0, 5.0); // front right leg
-    drawRectangularPrism(CT_X - 32.5, CT_Y - 6.5, CT_Z - 12.5, 5.0, 20.0, 5.0); // back left leg
-    drawRectangularPrism(CT_X + 32.5, CT_Y - 6.5, CT_Z - 12.5, 5.0, 20.0, 5.0); // back right leg
-    drawRectangularPrism(CT_X, CT_Y - 13, CT_Z, 70.0, 2.0, 30.0); // bottom plate
+    addRectangularPrism(CT_X, CT_Y, CT_Z, 70.0, 7.0, 30.0); // top plate
+    addRectangularPrism(CT_X - 32.5, CT_Y - 6.5, CT_Z + 12.5, 5.0, 20.0, 5.0); // front left leg
+    addRectangularPrism(CT_X + 32.5, CT_Y - 6.5, CT_Z + 12.5, 5.0, 20.0, 5.0); // front right leg
+    addRectangularPrism(CT_X - 32.5, CT_Y - 6.5, CT_Z - 12.5, 5.0, 20.0, 5.0); // back left leg
+    addRectangularPrism(CT_X + 32.5, CT_Y - 6.5, CT_Z - 12.5, 5.0, 20.0, 5.0); // back right leg
+    addRectangularPrism(CT_X, CT_Y - 13, CT_Z, 70.0, 2.0, 30.0); // bottom plate
 
     // Draw the endtable
     float ET_X = -60.0;
     float ET_Y = 13.0;
     float ET_Z = 70.0;
 
-    drawRectangularPrism(ET_X, ET_Y, ET_Z, 30.0, 3.0, 30.0); // top plate
-    drawRectangularPrism(ET_X - 14, ET_Y - 8.5, ET_Z + 13, 2.0, 20.0, 4.0); // front left leg
-    drawRectangularPrism(ET_X + 14, ET_Y - 8.5, ET_Z + 13, 2.0, 20.0, 4.0); // front right leg
-    drawRectangularPrism(ET_X - 14, ET_Y - 8.5, ET_Z - 13, 2.0, 20.0, 4.0); // back left leg
-    drawRectangularPrism(ET_X + 14, ET_Y - 8.5, ET_Z - 13, 2.0, 20.0, 4.0); // back right leg
-    drawRectangularPrism(ET_X, ET_Y - 19, ET_Z + 13, 30.0, 2.0, 4.0); // front bottom leg plate
-    drawRectangularPrism(ET_X, ET_Y - 19, ET_Z - 13, 30.0, 2.0, 4.0); // back bottom leg plate
+    addRectangularPrism(ET_X, ET_Y, ET_Z, 30.0, 3.0, 30.0); // top plate
+    addRectangularPrism(ET_X - 14, ET_Y - 8.5, ET_Z + 13, 2.0, 20.0, 4.0); // front left leg
+    addRectangularPrism(ET_X + 14, ET_Y - 8.5, ET_Z + 13, 2.0, 20.0, 4.0); // front right leg
+    addRectangularPrism(ET_X - 14, ET_Y - 8.5, ET_Z - 13, 2.0, 20.0, 4.0); // back left leg
+    addRectangularPrism(ET_X + 14, ET_Y - 8.5, ET_Z - 13, 2.0, 20.0, 4.0); // back right leg
+    addRectangularPrism(ET_X, ET_Y - 19, ET_Z + 13, 30.0, 2.0, 4.0); // front bottom leg plate
+    addRectangularPrism(ET_X, ET_Y - 19, ET_Z - 13, 30.0, 2.0, 4.0); // back bottom leg plate
 
     // Draw the chair
     float CH_X = 90.0;
     float CH_Y = 21.0;
     float CH_Z = 0.0;
 
-    drawRectangularPrism(CH_X, CH_Y, CH_Z, 2.0, 30.0, 20.0); // back rest
-    drawRectangularPrism(CH_X - 9, CH_Y - 14, CH_Z, 20.0, 2.0, 20.0); // sitting plate
-    drawRectangularPrism(CH_X - 18, CH_Y - 21, CH_Z + 9, 2.0, 15.0, 2.0); // front left leg
-    drawRectangularPrism(CH_X, CH_Y - 21, CH_Z + 9, 2.0, 15.0, 2.0); // front right leg
-    drawRectangularPrism(CH_X - 18, CH_Y - 21, CH_Z - 9, 2.0, 15.0, 2.0); // back left leg
-    drawRectangularPrism(CH_X, CH_Y - 21, CH_Z - 9, 2.0, 15.0, 2.0); // back right leg
+    addRectangularPrism(CH_X, CH_Y, CH_Z, 2.0, 30.0, 20.0); // back rest
+    addRectangularPrism(CH_X - 9, CH_Y - 14, CH_Z, 20.0, 2.0, 20.0); // sitting plate
+    addRectangularPrism(CH_X - 18, CH_Y - 21, CH_Z + 9, 2.0, 15.0, 2.0); // front left leg
+    addRectangularPrism(CH_X, CH_Y - 21, CH_Z + 9, 2.0, 15.0, 2.0); // front right leg
+    addRectangularPrism(CH_X - 18, CH_Y - 21, CH_Z - 9, 2.0, 15.0, 2.0); // back left leg
+    addRectangularPrism(CH_X, CH_Y - 21, CH_Z - 9, 2.0, 15.0, 2.0); // back right leg
 
     // Draw the left couch
     float LC_X = -60.0;
     float LC_Y = 0.0;
     float LC_Z = 10.0;
 
-    drawRectangularPrism(LC_X, LC_Y, LC_Z, 40.0, 15.0, 60.0); // sitting plate
-    drawRectangularPrism(LC_X - 15, LC_Y + 20, LC_Z, 10.0, 25.0, 60.0); // back plate
-    drawStraightCylinder(LC_X - 15.0, LC_Y + 32, LC_Z - 30.0, 8.0, 60.0, 48); // back plate cushion
-    drawHorizontalCylinder(LC_X - 10.0, LC_Y + 10, LC_Z + 30, 8.0, 30.0, 48); // front arm rest cushion
-    drawHorizontalCylinder(LC_X - 10.0, LC_Y + 10, LC_Z - 30, 8.0, 30.0, 48); // back arm rest cushion
+    addRectangularPrism(LC_X, LC_Y, LC_Z, 40.0, 15.0, 60.0); // sitting plate
+    addRectangularPrism(LC_X - 15, LC_Y + 20, LC_Z, 10.0, 25.0, 60.0); // back plate
+    addStraightCylinder(LC_X - 15.0, LC_Y + 32, LC_Z - 30.0, 8.0, 60.0, 48); // back plate cushion
+    addHorizontalCylinder(LC_X - 10.0, LC_Y + 10, LC_Z + 30, 8.0, 30.0, 48); // front arm rest cushion
+    addHorizontalCylinder(LC_X - 10.0, LC_Y + 10, LC_Z - 30, 8.0, 30.0, 48); // back arm rest cushion
 
     // Draw the front couch
     float FC_X = 15.0;
     float FC_Y = 0.0;
     float FC_Z = 70.0;
 
-    drawRectangularPrism(FC_X, FC_Y, FC_Z, 80.0, 15.0, 40.0); // sitting plate
-    drawRectangularPrism(FC_X, FC_Y + 20, FC_Z + 15, 80.0, 25.0, 10.0); // back plate
-    drawHorizontalCylinder(FC_X - 40.0, FC_Y + 32, FC_Z + 15.0, 8.0, 80.0, 48); // back plate cushion
-    drawStraightCylinder(FC_X - 40.0, FC_Y + 10, FC_Z - 20.0, 8.0, 30.0, 48); // left arm rest cushion
-    drawStraightCylinder(FC_X + 40.0, FC_Y + 10, FC_Z - 20.0, 8.0, 30.0, 48); // right arm rest cushion
+    addRectangularPrism(FC_X, FC_Y, FC_Z, 80.0, 15.0, 40.0); // sitting plate
+    addRectangularPrism(FC_X, FC_Y + 20, FC_Z + 15, 80.0, 25.0, 10.0); // back plate
+    addHorizontalCylinder(FC_X - 40.0, FC_Y + 32, FC_Z + 15.0, 8.0, 80.0, 48); // back plate cushion
+    addStraightCylinder(FC_X - 40.0, FC_Y + 10, FC_Z - 20.0, 8.0, 30.0, 48); // left arm rest cushion
+    addStraightCylinder(FC_X + 40.0, FC_Y + 10, FC_Z - 20.0, 8.0, 30.0, 48); // right arm rest cushion
 
     // Draw the ceiling fan
     float CF_X = 0.0;
     float CF_Y = 150.0;
     float CF_Z = 0.0;
 
-    drawHemisphere(CF_X, CF_Y, CF_Z, 20.0, 50, 50); // top connector sphere
-    drawRectangularPrism(CF_X, CF_Y - 25, CF_Z, 2.0, 10.0, 2.0); // connector to bottom sphere
-    drawHemisphere(CF_X, CF_Y - 30, CF_Z, 15.0, 50, 50); // bottom hemisphere for light
-    drawRectangularPrism(CF_X + 20, CF_Y - 25, CF_Z, 40.0, 2.0, 10.0); // right fan blade
-    drawRectangularPrism(CF_X - 20, CF_Y - 25, CF_Z, 40.0, 2.0, 10.0); // left fan blade
+    addHemisphere(CF_X, CF_Y, CF_Z, 20.0, 50, 50); // top connector sphere
+    addRectangularPrism(CF_X, CF_Y - 25, CF_Z, 2.0, 10.0, 2.0); // connector to bottom sphere
+    addHemisphere(CF_X, CF_Y - 30, CF_Z, 15.0, 50, 50); // bottom hemisphere for light
+    addRectangularPrism(CF_X + 20, CF_Y - 25, CF_Z, 40.0, 2.0, 10.0); // right fan blade
+    addRectangularPrism(CF_X - 20, CF_Y - 25, CF_Z, 40.0, 2.0, 10.0); // left fan blade
 
     // Draw the endtable binder
     float EB_X = -60.0;
     float EB_Y = 15.0;
     float EB_Z = 70.0;
 
-    drawRectangularPrism(EB_X, EB_Y, EB_Z, 10.0, 3.0, 15.0); // body
-    drawStraightCylinder(EB_X - 5, EB_Y, EB_Z - 7.5, 2.0, 15.0, 24); // spine
+    addRectangularPrism(EB_X, EB_Y, EB_Z, 10.0, 3.0, 15.0); // body
+    addStraightCylinder(EB_X - 5, EB_Y, EB_Z - 7.5, 2.0, 15.0, 24); // spine
 
     // Draw the coffee table binder
     float CB_X = 0.0;
     float CB_Y = 13.0;
     float CB_Z = 0.0;
 
-    drawRectangularPrism(CB_X, CB_Y, CB_Z, 10.0, 3.0, 15.0); // body
-    drawStraightCylinder(CB_X - 5, CB_Y, CB_Z - 7.5, 2.0, 15.0, 24); // spine
+    addRectangularPrism(CB_X, CB_Y, CB_Z, 10.0, 3.0, 15.0); // body
+    addStraightCylinder(CB_X - 5, CB_Y, CB_Z - 7.5, 2.0, 15.0, 24); // spine
 
     // Draw the switch
     float SW_X = -20.0;
     float SW_Y = 28.0;
     float SW_Z = -55.0;
 
-    drawRectangularPrism(SW_X, SW_Y, SW_Z, 20.0, 15.0, 2.0); // body
-    drawVerticalCylinder(SW_X - 8.5, SW_Y + 7.5, SW_Z, 2.5, 15.0, 24); // left controller
-    drawVerticalCylinder(SW_X + 8.5, SW_Y + 7.5, SW_Z, 2.5, 15.0, 24); // right controller
+    addRectangularPrism(SW_X, SW_Y, SW_Z, 20.0, 15.0, 2.0); // body
+    addVerticalCylinder(SW_X - 8.5, SW_Y + 7.5, SW_Z, 2.5, 15.0, 24); // left controller
+    addVerticalCylinder(SW_X + 8.5, SW_Y + 7.5, SW_Z, 2.5, 15.0, 24); // right controller
 
     // Draw the modem
     float MD_X = -14.0;
     float MD_Y = 35.0;
     float MD_Z = -47.5;
 
-    drawVerticalCylinder(MD_X, MD_Y, MD_Z, 5, 15.0, 24); // body
+    addVerticalCylinder(MD_X, MD_Y, MD_Z, 5, 15.0, 24); // body
+}
+
+
+// Function to draw the room from its buffers in one call
+void drawRoom(void) {
+    glBindBuffer(GL_ARRAY_BUFFER, roomBuffers[0]);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, roomBuffers[1]);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(RoomVertex), (void*)0);
+    glColorPointer(3, GL_FLOAT, sizeof(RoomVertex), (void*)(3 * sizeof(GLfloat)));
+    glDrawElements(GL_TRIANGLES, roomIndexCount, GL_UNSIGNED_INT, (void*)0);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+
+// Drawing routine
+void drawScene(void)
+{
+    // Clear the scene
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Apply rotations
+    // Apply rotations, the room itself never changes
     glLoadIdentity();
     glRotatef(VerticalAngle, 1.0, 0.0, 0.0);   // Rotate up/down along the x-axis
     glRotatef(HorizontalAngle, 0.0, 1.0, 0.0);
 
+    drawRoom();
+
     // Swap screen with buffer
 	glutSwapBuffers();
 }
@@ -429,6 +353,18 @@ void drawScene(void)
 void setup(void)
 {
 	glClearColor(1.0, 1.0, 1.0, 0.0);
+	glEnable(GL_DEPTH_TEST);
+
+	// Build the room once and keep it on the GPU
+	buildRoom();
+	glGenBuffers(2, roomBuffers);
+	glBindBuffer(GL_ARRAY_BUFFER, roomBuffers[0]);
+	glBufferData(GL_ARRAY_BUFFER, roomVertices.size() * sizeof(RoomVertex), roomVertices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, roomBuffers[1]);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, roomIndices.size() * sizeof(GLuint), roomIndices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	roomIndexCount = (GLsizei)roomIndices.size();
 }
 
 // OpenGL window reshape routine.
@@ -490,10 +426,40 @@ void printInteraction(void)
 	std::cout << "Press r to reset." << std::endl;
 }
 
+// Draws the room 5000 times turning it a little each time and prints the frames per second, for --benchmark.
+// Nothing is swapped to the screen, so the display's refresh rate does not limit it.
+void runBenchmark(void)
+{
+	const int frames = 5000;
+	resize(500, 500);
+	drawScene(); // warm up
+	glFinish();
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int i = 0; i < frames; i++)
+	{
+		HorizontalAngle = (float)(i % 360);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glLoadIdentity();
+		glRotatef(VerticalAngle, 1.0, 0.0, 0.0);
+		glRotatef(HorizontalAngle, 0.0, 1.0, 0.0);
+		drawRoom();
+	}
+	glFinish();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << "Room: " << roomVertices.size() << " vertices, " << roomIndexCount / 3 << " triangles, one draw call." << std::endl;
+	std::cout << frames << " frames in " << seconds * 1000.0 << " ms, " << frames / seconds << " frames per second." << std::endl;
+}
+
 // Main routine.
 int main(int argc, char** argv)
 {
-	printInteraction();
+	bool benchmark = argc > 1 && strcmp(argv[1], "--benchmark") == 0;
+	if (!benchmark)
+	{
+		printInteraction();
+	}
 	glutInit(&argc, argv);
 
 
@@ -511,5 +477,11 @@ int main(int argc, char** argv)
 
 	setup();
 
+	if (benchmark)
+	{
+		runBenchmark();
+		return 0;
+	}
+
 	glutMainLoop();
 }
@@ -0,0 +1,126 @@
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include "glad/glad.h"
+#include <GLFW/glfw3.h>
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+// glad here only loads OpenGL 3.3, buffer storage (4.4) is resolved by hand
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_RING)(GLenum target, GLsizeiptr size, const void *data, GLbitfield flags);
+
+// Triple buffered stream buffer for per-frame data such as text quads.
+// With OpenGL 4.4 the storage is persistently mapped, each frame writes its own third of the buffer with
+// plain memcpy and a fence stops us from overwriting a third the GPU may still be reading.
+// Older contexts fall back to staging the frame on the CPU and uploading it with one glBufferSubData per Commit.
+class RingBuffer
+{
+public:
+    static const int Sections = 3;
+    unsigned int ID = 0;
+    bool persistent = false;
+
+    // allocates Sections * sectionSize bytes, every Allocate is aligned to alignment
+    // ------------------------------------------------------------------------
+    void Create(GLsizeiptr sectionSize, GLint alignment)
+    {
+        this->sectionSize = sectionSize;
+        this->alignment = alignment;
+        PFNGLBUFFERSTORAGEPROC_RING bufferStorage = NULL;
+        if (GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4) || glfwExtensionSupported("GL_ARB_buffer_storage"))
+            bufferStorage = (PFNGLBUFFERSTORAGEPROC_RING)glfwGetProcAddress("glBufferStorage");
+        persistent = bufferStorage != NULL;
+
+        glGenBuffers(1, &ID);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+        if (persistent)
+        {
+            // map once for the lifetime of the buffer, coherent so writes need no flush
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            bufferStorage(GL_COPY_WRITE_BUFFER, Sections * sectionSize, NULL, flags);
+            mapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, Sections * sectionSize, flags);
+        }
+        else
+        {
+            glBufferData(GL_COPY_WRITE_BUFFER, Sections * sectionSize, NULL, GL_STREAM_DRAW);
+            staging.resize(Sections * sectionSize);
+            mapped = staging.data();
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        for (int i = 0; i < Sections; i++)
+            fences[i] = 0;
+    }
+
+    // waits until the GPU is done with this frame's section and rewinds the write head
+    // ------------------------------------------------------------------------
+    void BeginFrame()
+    {
+        if (fences[section])
+        {
+            GLenum result = glClientWaitSync(fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+            if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+                std::cout << "ERROR::RING_BUFFER: fence wait failed" << std::endl;
+            glDeleteSync(fences[section]);
+            fences[section] = 0;
+        }
+        head = section * sectionSize;
+        committed = head;
+    }
+
+    // reserves size bytes for this frame, returns a pointer to fill and the buffer offset in offset
+    // ------------------------------------------------------------------------
+    void* Allocate(GLsizeiptr size, GLintptr &offset)
+    {
+        GLintptr aligned = (head + alignment - 1) / alignment * alignment;
+        if (aligned + size > (section + 1) * sectionSize)
+        {
+            std::cout << "ERROR::RING_BUFFER: frame section of " << sectionSize << " bytes is full" << std::endl;
+            offset = -1;
+            return NULL;
+        }
+        offset = aligned;
+        head = aligned + size;
+        return mapped + aligned;
+    }
+
+    // makes everything written since the last Commit visible to the GPU
+    // ------------------------------------------------------------------------
+    void Commit()
+    {
+        if (!persistent && head > committed)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, ID);
+            glBufferSubData(GL_COPY_WRITE_BUFFER, committed, head - committed, staging.data() + committed);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+        committed = head;
+    }
+
+    // fences this frame's section and moves on, call after the frame's last draw
+    // ------------------------------------------------------------------------
+    void EndFrame()
+    {
+        Commit();
+        fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        section = (section + 1) % Sections;
+    }
+
+private:
+    GLsizeiptr sectionSize = 0;
+    GLint alignment = 16;
+    char* mapped = NULL;
+    std::vector<char> staging;
+    GLsync fences[Sections];
+    int section = 0;
+    GLintptr head = 0;
+    GLintptr committed = 0;
+};
+#endif
@@ -10,6 +10,7 @@
 #include "shader_m.h"
 #include "Numbers/NumShader.h"
 #include "camera.h"
+#include "RingBuffer.h"
 
 #include <freetype2/ft2build.h>
 #include FT_FREETYPE_H
@@ -55,6 +56,7 @@ glm::vec3 lightPos(0.0f, 0.0f, 2.0f);
 
 std::map<GLchar, Character> Characters;
 unsigned int VBO, cubeVAO, VAO;
+RingBuffer textRing; // per-frame text quads, written with memcpy
 
 
 int main()
@@ -271,13 +273,12 @@ int main()
     FT_Done_FreeType(ft);
 
     
-    // configure VAO/VBO for texture quads
+    // configure VAO for texture quads, vertices are streamed through a persistently mapped ring buffer
     // -----------------------------------
+    textRing.Create(64 * 1024, 4 * sizeof(float)); // 64 KB of quads per frame, aligned to one vertex
     glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
     glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, textRing.ID);
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
@@ -300,6 +301,9 @@ int main()
         // -----
         processInput(window);
 
+        // wait until the GPU has finished with this frame's third of the text ring
+        textRing.BeginFrame();
+
         // render
         // ------
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
@@ -611,6 +615,7 @@ int main()
         renderText(textShader, "128", 465.0f, 150.0f, 0.5f, glm::vec3(1.0f, 1.0f, 1.0f), face);
         renderText(textShader, "256", 610.0f, 150.0f, 0.5f, glm::vec3(1.0f, 1.0f, 1.0f), face);
 
+        textRing.EndFrame();
         glfwSwapBuffers(window);
         glfwPollEvents();
     }
@@ -642,6 +647,13 @@ void renderText(Shader &shader, std::string text, float x, float y, float scale,
     glActiveTexture(GL_TEXTURE0);
     glBindVertexArray(VAO);
 
+    // write every glyph quad of the string into the ring with plain stores, no GL call per glyph
+    GLintptr offset;
+    float (*quads)[6][4] = (float (*)[6][4])textRing.Allocate(text.size() * sizeof(float) * 6 * 4, offset);
+    if (quads == NULL)
+        return;
+    GLint firstVertex = (GLint)(offset / (4 * sizeof(float)));
+
     // iterate through all characters
     std::string::const_iterator c;
     for (c = text.begin(); c != text.end(); c++) 
@@ -653,7 +665,7 @@ void renderText(Shader &shader, std::string text, float x, float y, float scale,
 
         float w = ch.Size.x * scale;
         float h = ch.Size.y * scale;
-        // update VBO for each character
+        // quad for this character
         float vertices[6][4] = {
             { xpos,     ypos + h,   0.0f, 0.0f },            
             { xpos,     ypos,       0.0f, 1.0f },
@@ -663,18 +675,18 @@ void renderText(Shader &shader, std::string text, float x, float y, float scale,
             { xpos + w, ypos,       1.0f, 1.0f },
             { xpos + w, ypos + h,   1.0f, 0.0f }           
         };
-        // render glyph texture over quad
-        glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-        // update content of VBO memory
-        glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // be sure to use glBufferSubData and not glBufferData
-
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        // render quad
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+        memcpy(quads[c - text.begin()], vertices, sizeof(vertices));
         // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
         x += (ch.Advance >> 6) * scale; // bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
     }
+    textRing.Commit();
+
+    // render each glyph texture over its quad, the quads are already on the GPU
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        glBindTexture(GL_TEXTURE_2D, Characters[text[i]].TextureID);
+        glDrawArrays(GL_TRIANGLES, firstVertex + (GLint)(6 * i), 6);
+    }
     glBindVertexArray(0);
     glBindTexture(GL_TEXTURE_2D, 0);
 }
@@ -0,0 +1,292 @@
+///////////////////////////////////////////////////////////////
+// AttractorEnsemble.h
+//
+// Many trajectories of one of the OdeSystems.h systems integrated
+// together. Positions are stored as structure of arrays (x[], y[], z[])
+// so the update can work on 4, 8 or 16 trajectories per instruction.
+// The kernels are one template on the system, instantiated with GCC
+// vector types inside SSE, AVX2 and AVX-512 target functions, and the
+// widest one the CPU supports is picked at run time. Every kernel takes
+// the same forward Euler step as the scalar kernel, which for Lorenz is
+// the original updateLorenz math in float.
+//
+// State is double buffered: x, y, z always hold a complete snapshot
+// that can be drawn while the next steps are written into the back
+// buffer on a thread pool, then the buffers are swapped.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef ATTRACTOR_ENSEMBLE_H
+#define ATTRACTOR_ENSEMBLE_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include <iostream>
+#include "OdeSystems.h"
+#include "ThreadPool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ATTRACTOR_ENSEMBLE_X86
+#endif
+
+// Kernel signature, takes steps Euler steps of trajectories [begin, end) from the source arrays into the
+// destination arrays. Source and destination may be the same arrays.
+typedef void (*EnsembleKernel)(const float* xs, const float* ys, const float* zs,
+                               float* xd, float* yd, float* zd,
+                               size_t begin, size_t end, int steps,
+                               const SystemSet &systems, float dt);
+
+// Euler steps for W trajectories held in V, a float or a GCC vector of floats.
+// All steps are taken in registers, memory is touched once per batch.
+template <class System, typename V>
+inline void eulerLanes(const System &system, V &x, V &y, V &z, float dt, int steps) {
+    dt *= (float)System::timeScale;
+    for (int s = 0; s < steps; s++) {
+        V dx, dy, dz;
+        system.derivative(x, y, z, dx, dy, dz);
+        x = x + dx * dt; y = y + dy * dt; z = z + dz * dt;
+    }
+}
+
+// Scalar kernel
+template <class System>
+inline void ensembleStepScalar(const float* xs, const float* ys, const float* zs,
+                               float* xd, float* yd, float* zd,
+                               size_t begin, size_t end, int steps,
+                               const SystemSet &systems, float dt) {
+    const System &system = std::get<System>(systems);
+    for (size_t i = begin; i < end; i++) {
+        float x = xs[i], y = ys[i], z = zs[i];
+        eulerLanes(system, x, y, z, dt, steps);
+        xd[i] = x; yd[i] = y; zd[i] = z;
+    }
+}
+
+// The body shared by every vector kernel, V holds as many floats as the target's registers
+#define ENSEMBLE_VECTOR_BODY(V)                                                         \
+    const System &system = std::get<System>(systems);                                  \
+    const size_t width = sizeof(V) / sizeof(float);                                    \
+    size_t i = begin;                                                                  \
+    for (; i + width <= end; i += width) {                                             \
+        V x, y, z;                                                                     \
+        memcpy(&x, xs + i, sizeof(V)); memcpy(&y, ys + i, sizeof(V)); memcpy(&z, zs + i, sizeof(V)); \
+        eulerLanes(system, x, y, z, dt, steps);                                        \
+        memcpy(xd + i, &x, sizeof(V)); memcpy(yd + i, &y, sizeof(V)); memcpy(zd + i, &z, sizeof(V)); \
+    }                                                                                  \
+    ensembleStepScalar<System>(xs, ys, zs, xd, yd, zd, i, end, steps, systems, dt);
+
+#ifdef ATTRACTOR_ENSEMBLE_X86
+
+typedef float Float4 __attribute__((vector_size(16)));
+typedef float Float8 __attribute__((vector_size(32)));
+typedef float Float16 __attribute__((vector_size(64)));
+
+// 4 trajectories per instruction
+template <class System>
+__attribute__((target("sse2")))
+void ensembleStepSSE(const float* xs, const float* ys, const float* zs,
+                     float* xd, float* yd, float* zd,
+                     size_t begin, size_t end, int steps,
+                     const SystemSet &systems, float dt) {
+    ENSEMBLE_VECTOR_BODY(Float4)
+}
+
+// 8 trajectories per instruction
+template <class System>
+__attribute__((target("avx2")))
+void ensembleStepAVX2(const float* xs, const float* ys, const float* zs,
+                      float* xd, float* yd, float* zd,
+                      size_t begin, size_t end, int steps,
+                      const SystemSet &systems, float dt) {
+    ENSEMBLE_VECTOR_BODY(Float8)
+}
+
+// 16 trajectories per instruction
+template <class System>
+__attribute__((target("avx512f")))
+void ensembleStepAVX512(const float* xs, const float* ys, const float* zs,
+                        float* xd, float* yd, float* zd,
+                        size_t begin, size_t end, int steps,
+                        const SystemSet &systems, float dt) {
+    ENSEMBLE_VECTOR_BODY(Float16)
+}
+
+#endif
+
+// Every kernel compiled in, in order of preference
+enum EnsembleKernelType { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX2, KERNEL_AVX512, KERNEL_COUNT };
+static const char* kernelNames[KERNEL_COUNT] = { "scalar", "SSE", "AVX2", "AVX-512" };
+
+// True when this CPU can run the kernel
+inline bool kernelSupported(EnsembleKernelType type) {
+#ifdef ATTRACTOR_ENSEMBLE_X86
+    __builtin_cpu_init();
+    switch (type) {
+    case KERNEL_SSE: return __builtin_cpu_supports("sse2");
+    case KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+    case KERNEL_AVX512: return __builtin_cpu_supports("avx512f");
+    default: return true;
+    }
+#else
+    return type == KERNEL_SCALAR;
+#endif
+}
+
+// Kernel for a system and instruction set, resolved once when either changes
+inline EnsembleKernel kernelFunction(SystemType system, EnsembleKernelType type) {
+    EnsembleKernel kernel = NULL;
+    withSystem(system, SystemSet(), [&](const auto &sys) {
+        typedef typename std::decay<decltype(sys)>::type System;
+        kernel = ensembleStepScalar<System>;
+#ifdef ATTRACTOR_ENSEMBLE_X86
+        if (type == KERNEL_SSE) kernel = ensembleStepSSE<System>;
+        if (type == KERNEL_AVX2) kernel = ensembleStepAVX2<System>;
+        if (type == KERNEL_AVX512) kernel = ensembleStepAVX512<System>;
+#endif
+    });
+    return kernel;
+}
+
+// Widest kernel this CPU supports
+inline EnsembleKernelType bestKernel() {
+    for (int type = KERNEL_COUNT - 1; type > KERNEL_SCALAR; type--)
+        if (kernelSupported((EnsembleKernelType)type))
+            return (EnsembleKernelType)type;
+    return KERNEL_SCALAR;
+}
+
+class AttractorEnsemble {
+public:
+    std::vector<float> x, y, z;   // Front buffer, the latest complete step
+    SystemSet systems;            // Parameters of every system
+    float dt = 0.01f;             // Euler step size, scaled by the system's timeScale
+    SystemType system = SYSTEM_LORENZ;
+    EnsembleKernelType kernelType = KERNEL_SCALAR;
+    size_t chunkSize = 1 << 16;   // Trajectories per pool task, a multiple of every vector width
+
+    AttractorEnsemble() {
+        setKernel(bestKernel());
+    }
+
+    // Spread count trajectories along x around a starting point, spread is the total width of the cloud
+    void init(size_t count, float x0, float y0, float z0, float spread) {
+        x.resize(count); y.resize(count); z.resize(count);
+        backX.resize(count); backY.resize(count); backZ.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            float t = count > 1 ? (float)i / (float)(count - 1) - 0.5f : 0.0f;
+            x[i] = x0 + spread * t;
+            y[i] = y0;
+            z[i] = z0;
+        }
+    }
+
+    void setKernel(EnsembleKernelType type) {
+        kernelType = type;
+        kernel = kernelFunction(system, kernelType);
+    }
+
+    void setSystem(SystemType type) {
+        system = type;
+        kernel = kernelFunction(system, kernelType);
+    }
+
+    size_t size() const { return x.size(); }
+
+    // Advance every trajectory by steps Euler steps on this thread
+    void step(int steps = 1) {
+        kernel(x.data(), y.data(), z.data(), backX.data(), backY.data(), backZ.data(), 0, x.size(), steps, systems, dt);
+        swapBuffers();
+    }
+
+    // Start steps Euler steps on the pool and return at once, the front buffer stays readable until endSteps.
+    // Trajectories are independent, so each chunk runs all of its steps without waiting for the others.
+    void beginSteps(ThreadPool &pool, TaskGroup &group, int steps) {
+        if (steps <= 0) return;
+        for (size_t begin = 0; begin < x.size(); begin += chunkSize) {
+            size_t end = begin + chunkSize < x.size() ? begin + chunkSize : x.size();
+            pool.run(group, [this, begin, end, steps]() {
+                kernel(x.data(), y.data(), z.data(), backX.data(), backY.data(), backZ.data(), begin, end, steps, systems, dt);
+            });
+        }
+        pending = true;
+    }
+
+    // Wait for the steps started by beginSteps and make them the front buffer
+    void endSteps(ThreadPool &pool, TaskGroup &group) {
+        if (!pending) return;
+        pool.wait(group);
+        swapBuffers();
+        pending = false;
+    }
+
+    // Advance every trajectory by steps Euler steps using the whole pool
+    void step(ThreadPool &pool, int steps) {
+        TaskGroup group;
+        beginSteps(pool, group, steps);
+        endSteps(pool, group);
+    }
+
+    // Interleave the first count positions as xyz triples for drawing
+    void pack(float* dst, size_t count) const {
+        for (size_t i = 0; i < count; i++) {
+            dst[3 * i] = x[i]; dst[3 * i + 1] = y[i]; dst[3 * i + 2] = z[i];
+        }
+    }
+
+private:
+    EnsembleKernel kernel = ensembleStepScalar<LorenzSystem>;
+    std::vector<float> backX, backY, backZ;   // Back buffer, written by the steps in flight
+    bool pending = false;
+
+    void swapBuffers() {
+        x.swap(backX); y.swap(backY); z.swap(backZ);
+    }
+};
+
+// Checks every supported kernel of every system against the scalar kernel, returns false on any mismatch.
+// States are spread over the attractor first and then every kernel takes a single step from them, so
+// the comparison tests the kernel math rather than how fast chaos grows rounding differences (the
+// compiler may fuse multiply-adds in some kernels and not others).
+inline bool verifyEnsembleKernels(float dt, size_t count, int warmupSteps) {
+    bool ok = true;
+    for (int system = 0; system < SYSTEM_COUNT; system++) {
+        SystemStart origin = systemStart((SystemType)system);
+        AttractorEnsemble start;
+        start.dt = dt;
+        start.setSystem((SystemType)system);
+        start.setKernel(KERNEL_SCALAR);
+        start.init(count, (float)origin.x, (float)origin.y, (float)origin.z, 0.1f * (float)systemExtent((SystemType)system));
+        start.step(warmupSteps);
+
+        // A count that is not a multiple of 16 exercises every kernel's scalar tail
+        AttractorEnsemble reference = start;
+        reference.step();
+
+        for (int type = KERNEL_SSE; type < KERNEL_COUNT; type++) {
+            if (!kernelSupported((EnsembleKernelType)type)) {
+                std::cout << systemName((SystemType)system) << " " << kernelNames[type] << ": not supported by this CPU" << std::endl;
+                continue;
+            }
+            AttractorEnsemble test = start;
+            test.setKernel((EnsembleKernelType)type);
+            test.step();
+
+            float worst = 0.0f;
+            for (size_t i = 0; i < count; i++) {
+                float scale = 1.0f + std::fabs(reference.x[i]) + std::fabs(reference.y[i]) + std::fabs(reference.z[i]);
+                float diff = (std::fabs(test.x[i] - reference.x[i]) + std::fabs(test.y[i] - reference.y[i]) + std::fabs(test.z[i] - reference.z[i])) / scale;
+                if (!(diff <= worst)) worst = diff;
+            }
+            // A few float ulps allows for fused multiply-adds, anything more is a bug
+            bool pass = worst < 1e-6f;
+            std::cout << systemName((SystemType)system) << " " << kernelNames[type] << ": max relative difference " << worst << (pass ? " PASS" : " FAIL") << std::endl;
+            ok = ok && pass;
+        }
+    }
+    return ok;
+}
+
+#endif
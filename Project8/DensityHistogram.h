@@ -0,0 +1,150 @@
+///////////////////////////////////////////////////////////////
+// DensityHistogram.h
+//
+// Screen-space density rendering for large ensembles.
+// Every point is projected with the current OpenGL projection and
+// modelview matrices and counted in the pixel it lands in. Points are
+// split into one contiguous range per slot, and each slot counts into
+// its own histogram so no two threads ever touch the same counter;
+// the slots are merged row by row afterwards. The merged counts are
+// log tone mapped into a texture drawn as one screen quad by a shader,
+// so drawing costs the same for a thousand points or a hundred million.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef DENSITY_HISTOGRAM_H
+#define DENSITY_HISTOGRAM_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "ShaderFile.h"
+#include "ThreadPool.h"
+
+class DensityHistogram {
+public:
+    // Allocate counters for a width x height screen, one counter set per slot, and the texture and shader
+    // that show them. Returns false if the shader fails.
+    bool create(int width, int height, unsigned slots, const char* vertexPath, const char* fragmentPath) {
+        this->width = width;
+        this->height = height;
+        counts.assign(slots, std::vector<uint32_t>((size_t)width * height));
+        merged.assign((size_t)width * height, 0);
+        pixels.assign((size_t)width * height * 4, 0);
+
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        program = loadShaderProgram(vertexPath, fragmentPath);
+        if (!program) return false;
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "image"), 0);
+        glUseProgram(0);
+        // The quad's corners come from gl_VertexID, but the core profile still needs a vertex array bound
+        glGenVertexArrays(1, &vao);
+        return true;
+    }
+
+    // Count count points from the x, y, z arrays, matrix is column major projection * modelview
+    void accumulate(ThreadPool &pool, const float* x, const float* y, const float* z, size_t count, const float matrix[16]) {
+        size_t slots = counts.size();
+        size_t perSlot = (count + slots - 1) / slots;
+        pool.parallelFor(slots, 1, [&](size_t slot, size_t) {
+            std::vector<uint32_t> &bins = counts[slot];
+            std::fill(bins.begin(), bins.end(), 0u);
+            size_t begin = slot * perSlot;
+            size_t end = std::min(count, begin + perSlot);
+            const float* m = matrix;
+            float halfW = 0.5f * width, halfH = 0.5f * height;
+            for (size_t i = begin; i < end; i++) {
+                float px = x[i], py = y[i], pz = z[i];
+                float cw = m[3] * px + m[7] * py + m[11] * pz + m[15];
+                if (cw <= 0.0f) continue;
+                float cx = m[0] * px + m[4] * py + m[8] * pz + m[12];
+                float cy = m[1] * px + m[5] * py + m[9] * pz + m[13];
+                float inv = 1.0f / cw;
+                int sx = (int)((cx * inv + 1.0f) * halfW);
+                int sy = (int)((cy * inv + 1.0f) * halfH);
+                if (sx < 0 || sy < 0 || sx >= width || sy >= height) continue;
+                bins[(size_t)sy * width + sx]++;
+            }
+        });
+    }
+
+    // Merge the slots, tone map and upload the texture
+    void resolve(ThreadPool &pool) {
+        size_t slots = counts.size();
+        std::vector<uint32_t> rowMax(height, 0);
+        pool.parallelFor(height, 16, [&](size_t first, size_t last) {
+            for (size_t row = first; row < last; row++) {
+                uint32_t* dst = merged.data() + row * width;
+                memcpy(dst, counts[0].data() + row * width, width * sizeof(uint32_t));
+                for (size_t s = 1; s < slots; s++) {
+                    const uint32_t* src = counts[s].data() + row * width;
+                    for (int c = 0; c < width; c++)
+                        dst[c] += src[c];
+                }
+                rowMax[row] = *std::max_element(dst, dst + width);
+            }
+        });
+        uint32_t peak = *std::max_element(rowMax.begin(), rowMax.end());
+
+        // Log scale so sparse regions stay visible next to the dense core
+        float scale = peak > 0 ? 1.0f / std::log(1.0f + (float)peak) : 0.0f;
+        pool.parallelFor(height, 16, [&](size_t first, size_t last) {
+            for (size_t i = first * width; i < last * width; i++) {
+                float t = std::log(1.0f + (float)merged[i]) * scale;
+                // Black through red and yellow to white
+                float r = std::min(1.0f, 3.0f * t);
+                float g = std::min(1.0f, std::max(0.0f, 3.0f * t - 1.0f));
+                float b = std::min(1.0f, std::max(0.0f, 3.0f * t - 2.0f));
+                pixels[4 * i] = (unsigned char)(r * 255.0f);
+                pixels[4 * i + 1] = (unsigned char)(g * 255.0f);
+                pixels[4 * i + 2] = (unsigned char)(b * 255.0f);
+                pixels[4 * i + 3] = 255;
+            }
+        });
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+
+    // Draw the texture over the whole viewport, behind anything drawn after it
+    void draw() const {
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(program);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glBindVertexArray(vao);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        glBindVertexArray(0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glUseProgram(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    void destroy() {
+        glDeleteTextures(1, &texture);
+        glDeleteVertexArrays(1, &vao);
+        glDeleteProgram(program);
+        texture = vao = program = 0;
+    }
+
+private:
+    int width = 0, height = 0;
+    std::vector<std::vector<uint32_t>> counts;  // One histogram per slot
+    std::vector<uint32_t> merged;
+    std::vector<unsigned char> pixels;
+    GLuint texture = 0, program = 0, vao = 0;
+};
+
+#endif
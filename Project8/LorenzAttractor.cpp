@@ -2,15 +2,29 @@
 // LorenzAttractor.cpp
 //
 // This program is for project8 and is a representation of a lorenz attractor
-// in three dimensional space.
+// in three dimensional space. The Rossler, Thomas, Aizawa, Halvorsen and
+// Chen attractors can be shown as well.
 //
 // Interaction:
 // Use arrow keys to rotate the scene.
 // Press r to reset.
+// Press s to switch to the next system.
+// Press 1, 2 or 3 to integrate with Euler, RK4 or Dormand-Prince.
+// Hold f to fast-forward.
+// Press e to toggle the ensemble cloud.
+// Press d to show the ensemble as a density image instead of points.
+// When replaying a recording press , or . to jump back or forward.
+// Press h to show or hide the decimated history behind the trails.
 //
-// COMPILE: g++ -o lorenz_attractor LorenzAttractor.cpp -lglfw -lGLEW -lGL -lGLU
+// COMPILE: g++ -O2 -pthread -o lorenz_attractor LorenzAttractor.cpp -lglfw -lGLEW -lGL
+// The shaders (trail.vs, trail.frag, points.vs, points.frag, density.vs, density.frag) must be in the working directory.
 //
-// RUN: ./lorenz_attractor
+// RUN: ./lorenz_attractor [--trail <points>] [--rate <steps per second>] [--dt <step size>] [--ensemble <trajectories>] [--threads <count>] [--system <name>]
+//                         [--record <file>] [--replay <file>] [--history-tolerance <pixels>]
+// BENCHMARK: ./lorenz_attractor --bench
+// VERIFY SIMD KERNELS: ./lorenz_attractor --verify
+// PARAMETER SWEEP: ./lorenz_attractor --sweep [--sweep-x rho:0:200:1000] [--sweep-y sigma:5:20:1000]
+//                  [--sweep-transient <steps>] [--sweep-steps <steps>] [--sweep-maxima <count>] [--out sweep.csv|sweep.bin]
 //
 // Jonathon Moore.
 ///////////////////////////////////////////////////////////////
@@ -20,26 +34,299 @@
 #include <cmath>
 #include <vector>
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <chrono>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include "TrailBuffer.h"
+#include "ShaderFile.h"
+#include "TrailRenderer.h"
+#include "OdeIntegrator.h"
+#include "AttractorEnsemble.h"
+#include "ParameterSweep.h"
+#include "DensityHistogram.h"
+#include "TrajectoryFile.h"
 
-// Constants for the Lorenz system
-const float dt = 0.01f;
-const float sigma = 10.0f, rho = 28.0f, beta = 8.0f / 3.0f;
+// Step size, the parameters of every system live in OdeSystems.h
+double dt = 0.01;
 
-// Variables for two sets of Lorenz attractors
-float x_1 = 0.01f, y_1 = 0.0f, z_1 = 0.0f;
-float x_2 = -0.01f, y_2 = 0.0f, z_2 = 0.0f;
-std::vector<float> vertices1, vertices2;
+// System being shown, the two trajectories start this far either side of its starting point in x
+SystemType currentSystem = SYSTEM_LORENZ;
+const double startOffset = 0.01;
+
+// Variables for two sets of attractors
+OdeSimulation sim1, sim2;
+TrailBuffer trail1, trail2;
+TrailRenderer trailRenderer;
+
+// Everything older than the trails, decimated so a line drawn within this many pixels of every dropped point remains
+TrailHistory history1, history2;
+bool showHistory = true;
+float historyTolerance = 1.0f;
+
+// Window size in pixels
+const int windowWidth = 800, windowHeight = 600;
+
+// Simulation steps per real second, and how much faster f runs it
+double stepRate = 60.0;
+const double fastForward = 1000.0;
+
+// Cloud of trajectories started a hair apart, shows the whole ensemble diverging
+AttractorEnsemble ensemble;
+bool ensembleMode = false;
+size_t ensembleSize = 1000000;
+const float ensembleSpread = 0.001f;
+// Ensemble steps are capped per frame so fast-forward stays interactive with millions of points
+const int maxEnsembleSteps = 16;
+// At most this many points are sent to the GPU each frame
+const size_t maxDrawnPoints = 1000000;
+GLuint ensembleVBO = 0, ensembleVAO = 0;
+std::vector<float> ensemblePacked;
+// Shader the point cloud is drawn with, one color for every point
+GLuint pointProgram = 0;
+GLint pointMvpLocation = -1, pointColorLocation = -1;
+
+// Density mode counts every ensemble point into a screen sized histogram instead of drawing it
+bool densityMode = false;
+DensityHistogram density;
+
+// Worker threads for the ensemble, 0 means one per hardware thread
+unsigned threadCount = 0;
+std::unique_ptr<ThreadPool> pool;
+// Ensemble steps running in the background while the previous step is drawn
+TaskGroup ensembleSteps;
+
+// Recording of both trajectories. A reset or a change of system or integrator starts the next file,
+// named with -1, -2 and so on before the extension.
+std::string recordPath;
+int recordingIndex = 0;
+TrajectoryRecorder recorder;
+const int recordChunkSteps = 4096;
+// States of this frame's steps, collected for the recorder
+std::vector<OdeState> frameStates[2];
+
+// Replay of a recording instead of simulating, replayStep is the newest step shown
+TrajectoryReader replay;
+bool replayMode = false;
+size_t replayStep = 0;
+
+// Number of points each trail keeps before the oldest are overwritten
+int trailCapacity = 20000;
 
 // Variables for rotating the scene
 float angleX = 0.0f, angleY = 0.0f;
 
-// Function to update the Lorenz system
-void updateLorenz(float &x, float &y, float &z, float dt, float sigma, float rho, float beta, std::vector<float> &vertices) {
-    float dx = sigma * (y - x) * dt;
-    float dy = (x * (rho - z) - y) * dt;
-    float dz = (x * y - beta * z) * dt;
-    x += dx; y += dy; z += dz;
-    vertices.push_back(x); vertices.push_back(y); vertices.push_back(z);
+// Function to update a system, runs the given number of fixed steps and adds each one to the trail, its history and the recording
+void updateAttractor(OdeSimulation &sim, int steps, TrailBuffer &trail, TrailHistory &history, std::vector<OdeState> &states) {
+    states.clear();
+    sim.run(steps, [&](const OdeState &s) {
+        trail.append((float)s.x, (float)s.y, (float)s.z);
+        history.append((float)s.x, (float)s.y, (float)s.z);
+        if (recorder.isOpen()) states.push_back(s);
+    });
+}
+
+// Function to add a recorded step to both trails and histories
+void appendReplayStep(size_t step) {
+    OdeState a = replay.state(0, step), b = replay.state(1, step);
+    trail1.append((float)a.x, (float)a.y, (float)a.z);
+    trail2.append((float)b.x, (float)b.y, (float)b.z);
+    history1.append((float)a.x, (float)a.y, (float)a.z);
+    history2.append((float)b.x, (float)b.y, (float)b.z);
+}
+
+// Function to start the next recording file from the current state of both systems
+void startRecording() {
+    if (recordPath.empty()) return;
+    std::string path = recordPath;
+    if (recordingIndex > 0) {
+        size_t dot = path.find_last_of('.');
+        size_t slash = path.find_last_of('/');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) dot = path.size();
+        path.insert(dot, "-" + std::to_string(recordingIndex));
+    }
+    recordingIndex++;
+    if (!recorder.open(path, trajectoryHeader(sim1, 2, recordChunkSteps))) {
+        recordPath.clear();
+        return;
+    }
+    // Step 0 is the starting state
+    frameStates[0].assign(1, sim1.state);
+    frameStates[1].assign(1, sim2.state);
+    recorder.append(frameStates, 1);
+}
+
+// Function to show the replay up to step, the trails and histories are rebuilt from the mapped file without simulating.
+// The histories need every step from the start, the trails only the last trailCapacity they can hold.
+void seekReplay(size_t step) {
+    replayStep = std::min(step, replay.size() - 1);
+    trail1.clear();
+    trail2.clear();
+    history1.clear();
+    history2.clear();
+    size_t first = replayStep + 1 > (size_t)trailCapacity ? replayStep + 1 - trailCapacity : 0;
+    for (size_t i = 0; i <= replayStep; i++) {
+        OdeState a = replay.state(0, i), b = replay.state(1, i);
+        history1.append((float)a.x, (float)a.y, (float)a.z);
+        history2.append((float)b.x, (float)b.y, (float)b.z);
+        if (i >= first) {
+            trail1.append((float)a.x, (float)a.y, (float)a.z);
+            trail2.append((float)b.x, (float)b.y, (float)b.z);
+        }
+    }
+    std::cout << "Replay step " << replayStep << " of " << replay.size() - 1 << std::endl;
+}
+
+// Function to play the given number of recorded steps, stops at the end of the recording
+void updateReplay(int steps) {
+    for (int i = 0; i < steps && replayStep + 1 < replay.size(); i++) {
+        replayStep++;
+        appendReplayStep(replayStep);
+    }
+}
+
+// Starting point of the first or second trajectory of the current system
+OdeState startState(int which) {
+    SystemStart start = systemStart(currentSystem);
+    OdeState s = { start.x + (which == 0 ? startOffset : -startOffset), start.y, start.z };
+    return s;
+}
+
+// Function to switch both systems to another integrator
+void setIntegrator(IntegratorType type) {
+    if (sim1.integrator == type || replayMode) return;
+    sim1.setIntegrator(type);
+    sim2.setIntegrator(type);
+    std::cout << "Integrator: " << integratorNames[type] << std::endl;
+    if (recorder.isOpen()) startRecording();
+}
+
+// Function to measure how many fixed steps per second each integrator sustains
+void runBenchmark() {
+    std::cout << systemName(currentSystem) << " integrator throughput, dt = " << dt << std::endl;
+    for (int type = 0; type < INTEGRATOR_COUNT; type++) {
+        OdeSimulation sim;
+        sim.system = currentSystem;
+        sim.stepSize = dt;
+        sim.setIntegrator((IntegratorType)type);
+        sim.reset(startState(0));
+
+        // Batches of steps until at least a second has passed
+        long long steps = 0;
+        double seconds = 0.0;
+        auto begin = std::chrono::steady_clock::now();
+        while (seconds < 1.0) {
+            sim.run(100000);
+            steps += 100000;
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        }
+
+        std::cout << integratorNames[type] << ": " << (long long)(steps / seconds) << " steps/sec";
+        if (type == INTEGRATOR_DORMAND_PRINCE)
+            std::cout << " (" << (double)sim.dopri.accepted / steps << " substeps per step, " << sim.dopri.rejected << " rejected)";
+        // Printing the final state keeps the loop from being optimised away
+        std::cout << "  final state " << sim.state.x << " " << sim.state.y << " " << sim.state.z << std::endl;
+    }
+}
+
+// Function to measure ensemble throughput with every SIMD kernel the CPU supports
+void runEnsembleBenchmark() {
+    const size_t count = 4000000;
+    const int steps = 50;
+    OdeState start = startState(0);
+    std::cout << systemName(currentSystem) << " ensemble throughput, " << count << " trajectories" << std::endl;
+    for (int type = 0; type < KERNEL_COUNT; type++) {
+        if (!kernelSupported((EnsembleKernelType)type)) continue;
+        AttractorEnsemble cloud;
+        cloud.dt = ensemble.dt;
+        cloud.setSystem(currentSystem);
+        cloud.setKernel((EnsembleKernelType)type);
+        cloud.init(count, (float)start.x, (float)start.y, (float)start.z, ensembleSpread);
+        // One untimed step faults in both buffers
+        cloud.step();
+
+        // One pass per step, as the render loop runs it at normal speed
+        auto begin = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+            cloud.step();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        double perSecond = count * (double)steps / seconds;
+
+        // All steps in registers, as fast-forward runs it
+        begin = std::chrono::steady_clock::now();
+        cloud.step(steps);
+        double batched = count * (double)steps / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        // Each pass reads and writes 3 floats per trajectory
+        std::cout << kernelNames[type] << ": " << (long long)perSecond << " trajectory steps/sec ("
+                  << perSecond * 6.0 * sizeof(float) / 1e9 << " GB/s), " << (long long)batched
+                  << " with " << steps << " steps per pass" << std::endl;
+    }
+}
+
+// Function to measure how ensemble stepping scales from one thread to every hardware thread
+void runScalingBenchmark() {
+    const size_t count = 10000000;
+    const int steps = 20;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    OdeState start = startState(0);
+    AttractorEnsemble cloud;
+    cloud.dt = ensemble.dt;
+    cloud.setSystem(currentSystem);
+    std::cout << systemName(currentSystem) << " ensemble scaling, " << count << " trajectories, " << kernelNames[cloud.kernelType] << " kernel" << std::endl;
+
+    double oneThread = 0.0;
+    for (unsigned threads = 1; threads <= maxThreads; threads++) {
+        ThreadPool benchPool(threads);
+        cloud.init(count, (float)start.x, (float)start.y, (float)start.z, ensembleSpread);
+        // One untimed step faults in both buffers
+        cloud.step(benchPool, 1);
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int s = 0; s < steps; s++)
+            cloud.step(benchPool, 1);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        if (threads == 1) oneThread = seconds;
+
+        std::cout << threads << " threads: " << seconds * 1000.0 / steps << " ms/step, "
+                  << (long long)(count * (double)steps / seconds) << " trajectory steps/sec, speedup "
+                  << oneThread / seconds << "x" << std::endl;
+    }
+}
+
+// Function to finish any ensemble steps still running in the background
+void finishEnsembleSteps() {
+    if (pool)
+        ensemble.endSteps(*pool, ensembleSteps);
+}
+
+// Function to draw the ensemble as a point cloud, mvp is the matrix the trails are drawn with
+void drawEnsemble(const Mat4 &mvp) {
+    size_t count = std::min(ensemble.size(), maxDrawnPoints);
+    ensemblePacked.resize(count * 3);
+    ensemble.pack(ensemblePacked.data(), count);
+
+    glBindBuffer(GL_ARRAY_BUFFER, ensembleVBO);
+    glBufferData(GL_ARRAY_BUFFER, ensemblePacked.size() * sizeof(float), ensemblePacked.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glUseProgram(pointProgram);
+    glUniformMatrix4fv(pointMvpLocation, 1, GL_FALSE, mvp.m);
+    glUniform3f(pointColorLocation, 1.0f, 0.8f, 0.4f);
+    glBindVertexArray(ensembleVAO);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)count);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+// Function to draw the whole ensemble as a density image, mvp is the matrix the points would be drawn with
+void drawEnsembleDensity(const Mat4 &mvp) {
+    density.accumulate(*pool, ensemble.x.data(), ensemble.y.data(), ensemble.z.data(), ensemble.size(), mvp.m);
+    density.resolve(*pool);
+    density.draw();
 }
 
 // Function to check for OpenGL errors
@@ -52,17 +339,96 @@ void checkGLError() {
 
 // Function to reset the animation
 void resetAnimation() {
-    x_1 = 0.01f; y_1 = 0.0f; z_1 = 0.0f;
-    x_2 = -0.01f; y_2 = 0.0f; z_2 = 0.0f;
-    vertices1.clear();
-    vertices2.clear();
+    sim1.reset(startState(0));
+    sim2.reset(startState(1));
+    trail1.clear();
+    trail2.clear();
+    history1.clear();
+    history2.clear();
+    finishEnsembleSteps();
+    OdeState start = startState(0);
+    ensemble.init(ensembleSize, (float)start.x, (float)start.y, (float)start.z, ensembleSpread);
+    if (replayMode)
+        seekReplay(0);
+    else
+        startRecording();
+}
+
+// Function to switch every simulation to another system and start it over
+void setSystem(SystemType type) {
+    currentSystem = type;
+    sim1.system = sim2.system = type;
+    finishEnsembleSteps();
+    ensemble.setSystem(type);
+    trailRenderer.colorScale = (float)(1.0 / systemExtent(type));
+    // Pixels to attractor units at the origin: the camera is 100 away with a 45 degree field of view, and the view is scaled by 30 / extent
+    float unitsPerPixel = (float)(2.0 * 100.0 * std::tan(22.5 * 3.14159265 / 180.0) / windowHeight * systemExtent(type) / 30.0);
+    history1.tolerance = history2.tolerance = historyTolerance * unitsPerPixel;
+    resetAnimation();
+    std::cout << "System: " << systemName(type) << std::endl;
 }
 
 // Function to process user input
 void processInput(GLFWwindow* window) {
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
+    // r resets once per press, a held key would start a new recording file every frame
+    static bool rPressed = false;
+    bool rDown = glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS;
+    if (rDown && !rPressed) {
         resetAnimation();
     }
+    rPressed = rDown;
+    if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS) {
+        setIntegrator(INTEGRATOR_EULER);
+    }
+    if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS) {
+        setIntegrator(INTEGRATOR_RK4);
+    }
+    if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS) {
+        setIntegrator(INTEGRATOR_DORMAND_PRINCE);
+    }
+    // e toggles once per press rather than every frame it is held
+    static bool ePressed = false;
+    bool eDown = glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS;
+    if (eDown && !ePressed) {
+        ensembleMode = !ensembleMode;
+        std::cout << "Ensemble " << (ensembleMode ? "on" : "off") << ": " << ensemble.size()
+                  << " trajectories, " << kernelNames[ensemble.kernelType] << " kernel" << std::endl;
+    }
+    ePressed = eDown;
+    // d switches the ensemble between points and density, turning the ensemble on if needed
+    static bool dPressed = false;
+    bool dDown = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    if (dDown && !dPressed) {
+        densityMode = !densityMode;
+        if (densityMode) ensembleMode = true;
+        std::cout << "Ensemble drawn as " << (densityMode ? "density" : "points") << std::endl;
+    }
+    dPressed = dDown;
+    // h shows or hides the history once per press
+    static bool hPressed = false;
+    bool hDown = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if (hDown && !hPressed) {
+        showHistory = !showHistory;
+        std::cout << "History " << (showHistory ? "shown" : "hidden") << ": " << history1.size() << " and " << history2.size() << " points" << std::endl;
+    }
+    hPressed = hDown;
+    // s steps through the systems once per press
+    static bool sPressed = false;
+    bool sDown = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+    if (sDown && !sPressed && !replayMode) {
+        setSystem((SystemType)((currentSystem + 1) % SYSTEM_COUNT));
+    }
+    sPressed = sDown;
+    // , and . jump a twentieth of the recording back or forward
+    static bool commaPressed = false, periodPressed = false;
+    bool commaDown = glfwGetKey(window, GLFW_KEY_COMMA) == GLFW_PRESS;
+    bool periodDown = glfwGetKey(window, GLFW_KEY_PERIOD) == GLFW_PRESS;
+    if (replayMode && ((commaDown && !commaPressed) || (periodDown && !periodPressed))) {
+        size_t jump = std::max<size_t>(1, replay.size() / 20);
+        seekReplay(commaDown ? (replayStep > jump ? replayStep - jump : 0) : replayStep + jump);
+    }
+    commaPressed = commaDown;
+    periodPressed = periodDown;
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
         angleX -= 1.0f;
     }
@@ -77,85 +443,261 @@ void processInput(GLFWwindow* window) {
     }
 }
 
-// Function to apply color based on position
-void applyColor(float x, float y, float z) {
-    float r = fabs(x) / 30.0f;
-    float g = fabs(y) / 30.0f;
-    float b = fabs(z) / 30.0f;
-    glColor3f(r, g, b);
-}
-
 // Routine to output interaction instructions to the C++ window.
 void printInteraction(void)
 {
     std::cout << "Interaction:" << std::endl;
     std::cout << "Use arrow keys to rotate the scene." << std::endl;
     std::cout << "Press r to reset." << std::endl;
+    std::cout << "Press s to switch to the next system." << std::endl;
+    std::cout << "Press 1, 2 or 3 to integrate with Euler, RK4 or Dormand-Prince." << std::endl;
+    std::cout << "Hold f to fast-forward." << std::endl;
+    std::cout << "Press e to toggle the ensemble cloud." << std::endl;
+    std::cout << "Press d to show the ensemble as a density image instead of points." << std::endl;
+    std::cout << "When replaying a recording press , or . to jump back or forward." << std::endl;
+    std::cout << "Press h to show or hide the decimated history behind the trails." << std::endl;
 }
 
-int main() {
+int main(int argc, char** argv) {
+
+    // Optional trail length, step rate and step size
+    bool benchmark = false, verify = false, sweep = false;
+    SweepSettings sweepSettings;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--trail") == 0 && i + 1 < argc) {
+            trailCapacity = atoi(argv[++i]);
+            if (trailCapacity < 2) {
+                std::cerr << "Trail needs at least 2 points" << std::endl;
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc) {
+            stepRate = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--dt") == 0 && i + 1 < argc) {
+            dt = atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--ensemble") == 0 && i + 1 < argc) {
+            ensembleSize = strtoull(argv[++i], NULL, 10);
+        }
+        else if (strcmp(argv[i], "--system") == 0 && i + 1 < argc) {
+            const char* name = argv[++i];
+            int type = 0;
+            while (type < SYSTEM_COUNT && strcasecmp(name, systemName((SystemType)type)) != 0)
+                type++;
+            if (type == SYSTEM_COUNT) {
+                std::cerr << "Unknown system " << name << std::endl;
+                return -1;
+            }
+            currentSystem = (SystemType)type;
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            threadCount = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--bench") == 0) {
+            benchmark = true;
+        }
+        else if (strcmp(argv[i], "--verify") == 0) {
+            verify = true;
+        }
+        else if (strcmp(argv[i], "--sweep") == 0) {
+            sweep = true;
+        }
+        else if ((strcmp(argv[i], "--sweep-x") == 0 || strcmp(argv[i], "--sweep-y") == 0) && i + 1 < argc) {
+            SweepAxis &axis = argv[i][8] == 'x' ? sweepSettings.x : sweepSettings.y;
+            if (!parseSweepAxis(argv[++i], axis)) {
+                std::cerr << "Sweep axes look like rho:0:200:1000 (sigma, rho or beta)" << std::endl;
+                return -1;
+            }
+        }
+        else if (strcmp(argv[i], "--sweep-transient") == 0 && i + 1 < argc) {
+            sweepSettings.transientSteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sweep-steps") == 0 && i + 1 < argc) {
+            sweepSettings.measureSteps = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--sweep-maxima") == 0 && i + 1 < argc) {
+            sweepSettings.maxima = std::max(0, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            sweepSettings.output = argv[++i];
+        }
+        else if (strcmp(argv[i], "--history-tolerance") == 0 && i + 1 < argc) {
+            historyTolerance = (float)atof(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            if (!replay.open(argv[++i]) || replay.size() == 0 || replay.header.trajectories < 2) {
+                std::cerr << "Nothing to replay" << std::endl;
+                return -1;
+            }
+            replayMode = true;
+        }
+    }
+    if (stepRate <= 0.0 || dt <= 0.0 || historyTolerance <= 0.0f) {
+        std::cerr << "Step rate, step size and history tolerance must be positive" << std::endl;
+        return -1;
+    }
+
+    // The ensemble always takes Euler steps in float, matching the original updateLorenz
+    ensemble.dt = (float)dt;
+
+    // Headless modes, no window needed
+    if (verify) {
+        return verifyEnsembleKernels((float)dt, 100003, 1000) ? 0 : 1;
+    }
+    if (sweep) {
+        if (sweepSettings.x.name == sweepSettings.y.name || sweepSettings.measureSteps < 1 || sweepSettings.transientSteps < 0) {
+            std::cerr << "Sweep needs two different parameters and at least one measured step" << std::endl;
+            return -1;
+        }
+        sweepSettings.dt = dt;
+        ThreadPool sweepPool(threadCount);
+        return runParameterSweep(sweepSettings, sweepPool) ? 0 : 1;
+    }
+    if (benchmark) {
+        runBenchmark();
+        runEnsembleBenchmark();
+        runScalingBenchmark();
+        return 0;
+    }
+
+    // A replay shows the system it recorded and plays at the rate it was recorded
+    if (replayMode) {
+        currentSystem = (SystemType)replay.header.system;
+        dt = replay.header.dt;
+        ensemble.dt = (float)dt;
+        recordPath.clear();
+        std::cout << "Replaying " << replay.size() << " steps of " << systemName(currentSystem) << " recorded with "
+                  << integratorNames[replay.header.integrator] << ", dt = " << dt << std::endl;
+    }
+
+    // Both trajectories share system, step size and rate
+    sim1.stepSize = sim2.stepSize = dt;
+    sim1.stepRate = sim2.stepRate = stepRate;
+    pool.reset(new ThreadPool(threadCount));
 
     printInteraction();
 
     // Initialize GLFW
     if (!glfwInit()) return -1;
 
+    // Every draw goes through a shader, so ask for a 3.3 core context
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
     // Create a windowed mode window and its OpenGL context
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Lorenz Attractor", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(windowWidth, windowHeight, "Lorenz Attractor", NULL, NULL);
     if (!window) { glfwTerminate(); return -1; }
     glfwMakeContextCurrent(window);
 
-    // Initialize GLEW
+    // Initialize GLEW, experimental so it loads every entry point of the core context
+    glewExperimental = GL_TRUE;
     glewInit();
 
     // Enable depth test
     glEnable(GL_DEPTH_TEST);
 
     // Set up the viewport
-    glViewport(0, 0, 800, 600);
+    glViewport(0, 0, windowWidth, windowHeight);
 
-    // Set up the projection matrix
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0, 800.0 / 600.0, 1.0, 500.0);
+    // Set up the projection matrix, every shader gets it multiplied into its mvp
+    Mat4 projection = perspectiveMatrix(45.0f, (float)windowWidth / windowHeight, 1.0f, 500.0f);
+
+    // Build the shaders, nothing can be drawn without them. The density image keeps one histogram
+    // per pool thread so counting needs no atomics.
+    pointProgram = loadShaderProgram("points.vs", "points.frag");
+    if (!trailRenderer.create("trail.vs", "trail.frag") || !pointProgram
+        || !density.create(windowWidth, windowHeight, pool->size(), "density.vs", "density.frag")) {
+        glfwTerminate();
+        return -1;
+    }
+    pointMvpLocation = glGetUniformLocation(pointProgram, "mvp");
+    pointColorLocation = glGetUniformLocation(pointProgram, "color");
 
-    // Set up the modelview matrix
-    glMatrixMode(GL_MODELVIEW);
+    // Allocate the trail VBOs once, every frame only uploads the new points
+    trail1.create(trailCapacity);
+    trail2.create(trailCapacity);
+    history1.create(trailCapacity);
+    history2.create(trailCapacity);
+    glGenBuffers(1, &ensembleVBO);
+    glGenVertexArrays(1, &ensembleVAO);
+    glBindVertexArray(ensembleVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, ensembleVBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Start the first system now the buffers it fills exist
+    setSystem(currentSystem);
 
     // Main loop
+    double lastTime = glfwGetTime();
     while (!glfwWindowShouldClose(window)) {
         processInput(window);
-        updateLorenz(x_1, y_1, z_1, dt, sigma, rho, beta, vertices1);
-        updateLorenz(x_2, y_2, z_2, dt, sigma, rho, beta, vertices2);
+
+        // Run the fixed steps that fell due since the last frame, both systems share one clock
+        double now = glfwGetTime();
+        double speed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS ? fastForward : 1.0;
+        int steps = sim1.stepsDue(now - lastTime, speed);
+        lastTime = now;
+        if (replayMode) {
+            updateReplay(steps);
+        }
+        else {
+            updateAttractor(sim1, steps, trail1, history1, frameStates[0]);
+            updateAttractor(sim2, steps, trail2, history2, frameStates[1]);
+            recorder.append(frameStates, steps);
+        }
+        // Collect the ensemble steps started last frame, then start this frame's on the pool.
+        // They run while the front buffer is drawn below.
+        finishEnsembleSteps();
+        if (ensembleMode)
+            ensemble.beginSteps(*pool, ensembleSteps, std::min(steps, maxEnsembleSteps));
+
+        // Send this frame's new points to the GPU
+        trail1.flush();
+        trail2.flush();
+        history1.flush();
+        history2.flush();
 
         // Clear the color buffer and depth buffer
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Load the identity matrix
-        glLoadIdentity();
-
         // Set the camera position and orientation
-        gluLookAt(0, 0, 100, 0, 0, 0, 0, 1, 0);
+        Mat4 modelview = lookAtMatrix(0, 0, 100, 0, 0, 0, 0, 1, 0);
 
         // Apply rotations
-        glRotatef(angleX, 1.0f, 0.0f, 0.0f);
-        glRotatef(angleY, 0.0f, 1.0f, 0.0f);
+        modelview = modelview * rotationXMatrix(angleX) * rotationYMatrix(angleY);
 
-        // Draw the first Lorenz attractor
-        glBegin(GL_LINE_STRIP);
-        for (size_t i = 0; i < vertices1.size(); i += 3) {
-            applyColor(vertices1[i], vertices1[i + 1], vertices1[i + 2]);
-            glVertex3f(vertices1[i], vertices1[i + 1], vertices1[i + 2]);
-        }
-        glEnd();
+        // Scale smaller attractors up to the size of the Lorenz attractor
+        modelview = modelview * scaleMatrix((float)(30.0 / systemExtent(currentSystem)));
+        Mat4 mvp = projection * modelview;
+
+        // The density image fills the viewport, so it goes down first as the background the trails are drawn over
+        if (ensembleMode && densityMode)
+            drawEnsembleDensity(mvp);
 
-        // Draw the second Lorenz attractor
-        glBegin(GL_LINE_STRIP);
-        for (size_t i = 0; i < vertices2.size(); i += 3) {
-            applyColor(vertices2[i], vertices2[i + 1], vertices2[i + 2]);
-            glVertex3f(vertices2[i], vertices2[i + 1], vertices2[i + 2]);
+        // Draw both attractors
+        trailRenderer.begin(mvp, windowWidth, windowHeight);
+        if (showHistory) {
+            trailRenderer.draw(history1);
+            trailRenderer.draw(history2);
         }
-        glEnd();
+        trailRenderer.draw(trail1, showHistory && history1.size() > 1);
+        trailRenderer.draw(trail2, showHistory && history2.size() > 1);
+        trailRenderer.end();
+
+        // Draw the ensemble cloud
+        if (ensembleMode && !densityMode)
+            drawEnsemble(mvp);
 
         // Check for OpenGL errors
         checkGLError();
@@ -168,6 +710,18 @@ int main() {
     }
 
     // Clean up
+    finishEnsembleSteps();
+    recorder.close();
+    pool.reset();
+    trail1.destroy();
+    trail2.destroy();
+    history1.destroy();
+    history2.destroy();
+    trailRenderer.destroy();
+    glDeleteBuffers(1, &ensembleVBO);
+    glDeleteVertexArrays(1, &ensembleVAO);
+    glDeleteProgram(pointProgram);
+    density.destroy();
     glfwDestroyWindow(window);
     glfwTerminate();
     return 0;
@@ -0,0 +1,228 @@
+///////////////////////////////////////////////////////////////
+// OdeIntegrator.h
+//
+// Fixed-timestep simulation stage for the systems in OdeSystems.h.
+// The simulation advances in steps of a fixed size at a fixed rate
+// in real time, independent of how fast frames are rendered. Each
+// step can use forward Euler, classic RK4 or adaptive Dormand-Prince
+// (which takes as many error controlled substeps as it needs to
+// cover one fixed step). The integrators are templates on the system
+// so every system/integrator pair compiles to its own inlined loop.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef ODE_INTEGRATOR_H
+#define ODE_INTEGRATOR_H
+
+#include <algorithm>
+#include <cmath>
+#include "OdeSystems.h"
+
+// Available integration methods
+enum IntegratorType { INTEGRATOR_EULER, INTEGRATOR_RK4, INTEGRATOR_DORMAND_PRINCE, INTEGRATOR_COUNT };
+static const char* integratorNames[INTEGRATOR_COUNT] = { "Euler", "RK4", "Dormand-Prince" };
+
+// Position of one trajectory, double precision so the adaptive method can meet tight tolerances
+struct OdeState {
+    double x, y, z;
+};
+
+// Right hand side of the system's equations
+template <class System>
+inline OdeState derivative(const System &system, const OdeState &s) {
+    OdeState d;
+    system.derivative(s.x, s.y, s.z, d.x, d.y, d.z);
+    return d;
+}
+
+// s + h * d
+inline OdeState odeAdd(const OdeState &s, double h, const OdeState &d) {
+    OdeState r = { s.x + h * d.x, s.y + h * d.y, s.z + h * d.z };
+    return r;
+}
+
+// One forward Euler step
+template <class System>
+inline void stepEuler(const System &system, OdeState &s, double h) {
+    s = odeAdd(s, h, derivative(system, s));
+}
+
+// One classic fourth order Runge-Kutta step
+template <class System>
+inline void stepRK4(const System &system, OdeState &s, double h) {
+    OdeState k1 = derivative(system, s);
+    OdeState k2 = derivative(system, odeAdd(s, h * 0.5, k1));
+    OdeState k3 = derivative(system, odeAdd(s, h * 0.5, k2));
+    OdeState k4 = derivative(system, odeAdd(s, h, k3));
+    s.x += h / 6.0 * (k1.x + 2.0 * k2.x + 2.0 * k3.x + k4.x);
+    s.y += h / 6.0 * (k1.y + 2.0 * k2.y + 2.0 * k3.y + k4.y);
+    s.z += h / 6.0 * (k1.z + 2.0 * k2.z + 2.0 * k3.z + k4.z);
+}
+
+// Adaptive Dormand-Prince 5(4) with first-same-as-last reuse.
+// The substep size is kept between calls so a steady trajectory settles on a good size.
+class DormandPrince {
+public:
+    double tolerance = 1e-9;    // Relative and absolute error target per substep
+    double h = 0.001;           // Current substep size
+    long long accepted = 0;     // Substeps kept
+    long long rejected = 0;     // Substeps thrown away and retried smaller
+
+    // Forget the cached derivative, call whenever the state is changed from outside
+    void reset() {
+        haveK1 = false;
+    }
+
+    // Integrate s forward by exactly dt
+    template <class System>
+    void advance(const System &system, OdeState &s, double dt) {
+        // Butcher tableau
+        const double a21 = 1.0 / 5.0;
+        const double a31 = 3.0 / 40.0, a32 = 9.0 / 40.0;
+        const double a41 = 44.0 / 45.0, a42 = -56.0 / 15.0, a43 = 32.0 / 9.0;
+        const double a51 = 19372.0 / 6561.0, a52 = -25360.0 / 2187.0, a53 = 64448.0 / 6561.0, a54 = -212.0 / 729.0;
+        const double a61 = 9017.0 / 3168.0, a62 = -355.0 / 33.0, a63 = 46732.0 / 5247.0, a64 = 49.0 / 176.0, a65 = -5103.0 / 18656.0;
+        const double b1 = 35.0 / 384.0, b3 = 500.0 / 1113.0, b4 = 125.0 / 192.0, b5 = -2187.0 / 6784.0, b6 = 11.0 / 84.0;
+        // Difference between the fifth and fourth order weights
+        const double e1 = 71.0 / 57600.0, e3 = -71.0 / 16695.0, e4 = 71.0 / 1920.0, e5 = -17253.0 / 339200.0, e6 = 22.0 / 525.0, e7 = -1.0 / 40.0;
+
+        if (!haveK1) {
+            k1 = derivative(system, s);
+            haveK1 = true;
+        }
+
+        // Stop within rounding of dt rather than take a vanishing final substep
+        double t = 0.0;
+        while (dt - t > dt * 1e-12) {
+            double step = std::min(h, dt - t);
+            OdeState y, k2, k3, k4, k5, k6, k7;
+
+            y.x = s.x + step * a21 * k1.x;
+            y.y = s.y + step * a21 * k1.y;
+            y.z = s.z + step * a21 * k1.z;
+            k2 = derivative(system, y);
+
+            y.x = s.x + step * (a31 * k1.x + a32 * k2.x);
+            y.y = s.y + step * (a31 * k1.y + a32 * k2.y);
+            y.z = s.z + step * (a31 * k1.z + a32 * k2.z);
+            k3 = derivative(system, y);
+
+            y.x = s.x + step * (a41 * k1.x + a42 * k2.x + a43 * k3.x);
+            y.y = s.y + step * (a41 * k1.y + a42 * k2.y + a43 * k3.y);
+            y.z = s.z + step * (a41 * k1.z + a42 * k2.z + a43 * k3.z);
+            k4 = derivative(system, y);
+
+            y.x = s.x + step * (a51 * k1.x + a52 * k2.x + a53 * k3.x + a54 * k4.x);
+            y.y = s.y + step * (a51 * k1.y + a52 * k2.y + a53 * k3.y + a54 * k4.y);
+            y.z = s.z + step * (a51 * k1.z + a52 * k2.z + a53 * k3.z + a54 * k4.z);
+            k5 = derivative(system, y);
+
+            y.x = s.x + step * (a61 * k1.x + a62 * k2.x + a63 * k3.x + a64 * k4.x + a65 * k5.x);
+            y.y = s.y + step * (a61 * k1.y + a62 * k2.y + a63 * k3.y + a64 * k4.y + a65 * k5.y);
+            y.z = s.z + step * (a61 * k1.z + a62 * k2.z + a63 * k3.z + a64 * k4.z + a65 * k5.z);
+            k6 = derivative(system, y);
+
+            // Fifth order solution, its derivative is the next substep's k1
+            y.x = s.x + step * (b1 * k1.x + b3 * k3.x + b4 * k4.x + b5 * k5.x + b6 * k6.x);
+            y.y = s.y + step * (b1 * k1.y + b3 * k3.y + b4 * k4.y + b5 * k5.y + b6 * k6.y);
+            y.z = s.z + step * (b1 * k1.z + b3 * k3.z + b4 * k4.z + b5 * k5.z + b6 * k6.z);
+            k7 = derivative(system, y);
+
+            // Scaled error estimate, 1.0 means exactly on tolerance
+            double ex = step * (e1 * k1.x + e3 * k3.x + e4 * k4.x + e5 * k5.x + e6 * k6.x + e7 * k7.x);
+            double ey = step * (e1 * k1.y + e3 * k3.y + e4 * k4.y + e5 * k5.y + e6 * k6.y + e7 * k7.y);
+            double ez = step * (e1 * k1.z + e3 * k3.z + e4 * k4.z + e5 * k5.z + e6 * k6.z + e7 * k7.z);
+            double err = std::max(std::fabs(ex) / (tolerance + tolerance * std::max(std::fabs(s.x), std::fabs(y.x))),
+                         std::max(std::fabs(ey) / (tolerance + tolerance * std::max(std::fabs(s.y), std::fabs(y.y))),
+                                  std::fabs(ez) / (tolerance + tolerance * std::max(std::fabs(s.z), std::fabs(y.z)))));
+
+            // Standard step size controller, growth and shrink are clamped
+            double factor = err == 0.0 ? 5.0 : std::min(5.0, std::max(0.2, 0.9 * std::pow(err, -0.2)));
+            if (err <= 1.0) {
+                t += step;
+                s = y;
+                k1 = k7;
+                accepted++;
+                // A substep clipped to land on dt says nothing about the size the trajectory wants
+                if (step == h)
+                    h *= factor;
+            }
+            else {
+                h = step * factor;
+                rejected++;
+            }
+        }
+    }
+
+private:
+    OdeState k1;
+    bool haveK1 = false;
+};
+
+// One trajectory advanced at a fixed step rate in real time
+class OdeSimulation {
+public:
+    OdeState state;
+    SystemSet systems;                  // Parameters of every system
+    SystemType system = SYSTEM_LORENZ;  // System being integrated
+    IntegratorType integrator = INTEGRATOR_RK4;
+    double stepSize = 0.01;             // Simulated time covered by one step, scaled by the system's timeScale
+    double stepRate = 60.0;             // Steps per real second at normal speed
+    int maxStepsPerFrame = 200000;      // Stops a slow frame from snowballing into ever more work
+    DormandPrince dopri;
+
+    void reset(const OdeState &start) {
+        state = start;
+        accumulator = 0.0;
+        dopri.reset();
+    }
+
+    void setIntegrator(IntegratorType type) {
+        integrator = type;
+        dopri.reset();
+    }
+
+    // Advance by steps fixed steps and call sink(state) after each one.
+    // The system and integrator are chosen once here, the loops below are specialised for each pair.
+    template <typename Sink>
+    void run(int steps, Sink sink) {
+        withSystem(system, systems, [&](const auto &sys) {
+            double h = stepSize * sys.timeScale;
+            switch (integrator) {
+            case INTEGRATOR_EULER:
+                for (int i = 0; i < steps; i++) { stepEuler(sys, state, h); sink(state); }
+                break;
+            case INTEGRATOR_RK4:
+                for (int i = 0; i < steps; i++) { stepRK4(sys, state, h); sink(state); }
+                break;
+            default:
+                for (int i = 0; i < steps; i++) { dopri.advance(sys, state, h); sink(state); }
+                break;
+            }
+        });
+    }
+
+    // Advance by steps fixed steps without recording them
+    void run(int steps) {
+        run(steps, [](const OdeState&) {});
+    }
+
+    // Converts elapsed real time into the number of fixed steps now due, speed scales the step rate.
+    // Leftover fractions of a step carry over to the next frame.
+    int stepsDue(double elapsedSeconds, double speed) {
+        accumulator += elapsedSeconds * stepRate * speed;
+        int steps = (int)accumulator;
+        accumulator -= steps;
+        if (steps > maxStepsPerFrame) {
+            steps = maxStepsPerFrame;
+            accumulator = 0.0;
+        }
+        return steps;
+    }
+
+private:
+    double accumulator = 0.0;   // Fractional steps carried into the next frame
+};
+
+#endif
@@ -0,0 +1,191 @@
+///////////////////////////////////////////////////////////////
+// OdeSystems.h
+//
+// Three dimensional chaotic systems as small functor structs.
+// Each system holds its parameters and a templated derivative, so the
+// same code is used for double precision trajectories, float ensembles
+// and GCC vector types holding 4, 8 or 16 floats. Integrators and
+// kernels take the system as a template parameter and inline the
+// derivative; picking a system at run time happens once per batch of
+// steps in withSystem, never inside the loop.
+//
+// To add a system write one struct with name, timeScale, extent, start
+// and derivative, add it to SystemType, SystemSet and withSystem.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef ODE_SYSTEMS_H
+#define ODE_SYSTEMS_H
+
+#include <cmath>
+#include <cstddef>
+#include <tuple>
+
+// Scalar type matching T: double for double, float for float and for GCC vectors of float.
+// Parameters are converted to it, vector arithmetic broadcasts scalars to every lane.
+template <typename T> struct ScalarOf { typedef float type; };
+template <> struct ScalarOf<double> { typedef double type; };
+template <typename T> inline typename ScalarOf<T>::type param(double v) { return (typename ScalarOf<T>::type)v; }
+
+// r = sin(v) for a scalar, or for every lane of a GCC vector
+inline void sine(const float &v, float &r) { r = std::sin(v); }
+inline void sine(const double &v, double &r) { r = std::sin(v); }
+
+// The vector version stays in vector registers: v is reduced by the nearest multiple k of pi (pi split in
+// three so k * pi is exact enough), sin of the remainder in [-pi/2, pi/2] is its Taylor series to x^11
+// and the sign flips for odd k. Within 2e-7 of std::sin, a couple of float ulps, for |v| < 2^22, far
+// beyond any attractor's extent.
+template <typename V> inline void sine(const V &v, V &r) {
+    typedef int Lanes __attribute__((vector_size(sizeof(V))));
+    const float round = 12582912.0f;   // 1.5 * 2^23, adding it leaves v / pi rounded in the low mantissa bits
+    V t = v * 0.318309886183790671538f + round;
+    V k = t - round;
+    V x = v - k * 3.140625f;
+    x = x - k * 9.67502593994140625e-4f;
+    x = x - k * 1.509957990978376432e-7f;
+    V x2 = x * x;
+    V p = ((((x2 * (-1.0f / 39916800.0f) + 1.0f / 362880.0f) * x2 - 1.0f / 5040.0f) * x2 + 1.0f / 120.0f) * x2 - 1.0f / 6.0f) * x2;
+    V s = x + x * p;
+    r = (V)((Lanes)s ^ (((Lanes)t & 1) << 31));
+}
+
+// Starting point of a system
+struct SystemStart {
+    double x, y, z;
+};
+
+struct LorenzSystem {
+    static constexpr const char* name = "Lorenz";
+    static constexpr double timeScale = 1.0;   // Step size relative to Lorenz, fast systems need smaller Euler steps
+    static constexpr double extent = 30.0;   // Rough half width, used to fit the view and scale colors
+    static constexpr SystemStart start = { 0.0, 0.0, 0.0 };
+    double sigma = 10.0, rho = 28.0, beta = 8.0 / 3.0;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        dx = param<T>(sigma) * (y - x);
+        dy = x * (param<T>(rho) - z) - y;
+        dz = x * y - param<T>(beta) * z;
+    }
+};
+
+struct RosslerSystem {
+    static constexpr const char* name = "Rossler";
+    static constexpr double timeScale = 2.0;
+    static constexpr double extent = 12.0;
+    static constexpr SystemStart start = { 0.1, 0.0, 0.0 };
+    double a = 0.2, b = 0.2, c = 5.7;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        dx = -y - z;
+        dy = x + param<T>(a) * y;
+        dz = param<T>(b) + z * (x - param<T>(c));
+    }
+};
+
+struct ThomasSystem {
+    static constexpr const char* name = "Thomas";
+    static constexpr double timeScale = 5.0;
+    static constexpr double extent = 4.0;
+    static constexpr SystemStart start = { 0.1, 0.0, 0.0 };
+    double b = 0.208186;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        T sx, sy, sz;
+        sine(x, sx); sine(y, sy); sine(z, sz);
+        dx = sy - param<T>(b) * x;
+        dy = sz - param<T>(b) * y;
+        dz = sx - param<T>(b) * z;
+    }
+};
+
+struct AizawaSystem {
+    static constexpr const char* name = "Aizawa";
+    static constexpr double timeScale = 1.0;
+    static constexpr double extent = 1.5;
+    static constexpr SystemStart start = { 0.1, 0.0, 0.0 };
+    double a = 0.95, b = 0.7, c = 0.6, d = 3.5, e = 0.25, f = 0.1;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        T zb = z - param<T>(b);
+        dx = zb * x - param<T>(d) * y;
+        dy = param<T>(d) * x + zb * y;
+        dz = param<T>(c) + param<T>(a) * z - z * z * z * param<T>(1.0 / 3.0)
+           - (x * x + y * y) * (param<T>(1.0) + param<T>(e) * z) + param<T>(f) * z * x * x * x;
+    }
+};
+
+struct HalvorsenSystem {
+    static constexpr const char* name = "Halvorsen";
+    static constexpr double timeScale = 1.0;
+    static constexpr double extent = 12.0;
+    static constexpr SystemStart start = { 1.0, 0.0, 0.0 };
+    double a = 1.89;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        typename ScalarOf<T>::type four = param<T>(4.0);
+        dx = -param<T>(a) * x - four * y - four * z - y * y;
+        dy = -param<T>(a) * y - four * z - four * x - z * z;
+        dz = -param<T>(a) * z - four * x - four * y - x * x;
+    }
+};
+
+struct ChenSystem {
+    static constexpr const char* name = "Chen";
+    static constexpr double timeScale = 0.2;
+    static constexpr double extent = 30.0;
+    static constexpr SystemStart start = { 0.0, 0.0, 0.0 };
+    double a = 35.0, b = 3.0, c = 28.0;
+
+    template <typename T>
+    void derivative(const T &x, const T &y, const T &z, T &dx, T &dy, T &dz) const {
+        dx = param<T>(a) * (y - x);
+        dy = param<T>(c - a) * x - x * z + param<T>(c) * y;
+        dz = x * y - param<T>(b) * z;
+    }
+};
+
+// Every system, in the order the demo cycles through them
+enum SystemType { SYSTEM_LORENZ, SYSTEM_ROSSLER, SYSTEM_THOMAS, SYSTEM_AIZAWA, SYSTEM_HALVORSEN, SYSTEM_CHEN, SYSTEM_COUNT };
+
+// One instance of each system with its current parameters, std::get<LorenzSystem>(set) picks one
+typedef std::tuple<LorenzSystem, RosslerSystem, ThomasSystem, AizawaSystem, HalvorsenSystem, ChenSystem> SystemSet;
+
+// Calls f with the concrete system for type, so f is compiled once per system with everything inlined
+template <typename F>
+inline void withSystem(SystemType type, const SystemSet &systems, F f) {
+    switch (type) {
+    case SYSTEM_LORENZ: f(std::get<LorenzSystem>(systems)); break;
+    case SYSTEM_ROSSLER: f(std::get<RosslerSystem>(systems)); break;
+    case SYSTEM_THOMAS: f(std::get<ThomasSystem>(systems)); break;
+    case SYSTEM_AIZAWA: f(std::get<AizawaSystem>(systems)); break;
+    case SYSTEM_HALVORSEN: f(std::get<HalvorsenSystem>(systems)); break;
+    default: f(std::get<ChenSystem>(systems)); break;
+    }
+}
+
+// Name, extent and start of a system chosen at run time
+inline const char* systemName(SystemType type) {
+    const char* name = "";
+    withSystem(type, SystemSet(), [&](const auto &system) { name = system.name; });
+    return name;
+}
+
+inline double systemExtent(SystemType type) {
+    double extent = 1.0;
+    withSystem(type, SystemSet(), [&](const auto &system) { extent = system.extent; });
+    return extent;
+}
+
+inline SystemStart systemStart(SystemType type) {
+    SystemStart start = { 0.0, 0.0, 0.0 };
+    withSystem(type, SystemSet(), [&](const auto &system) { start = system.start; });
+    return start;
+}
+
+#endif
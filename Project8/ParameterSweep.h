@@ -0,0 +1,246 @@
+///////////////////////////////////////////////////////////////
+// ParameterSweep.h
+//
+// Headless parameter sweep of the Lorenz system.
+// Two of sigma, rho and beta are stepped over a grid and every grid
+// point is integrated on the thread pool. Each point reduces its run
+// to summary statistics as it goes, nothing per step is stored:
+//   - the local maxima of z (the return map used for bifurcation
+//     diagrams), as count/min/max/mean plus the last few values
+//   - the largest Lyapunov exponent, from the same two nearby
+//     trajectories the demo draws, renormalized at a fixed interval
+// Results are written a block of rows at a time as CSV, or as compact
+// binary records when the output name ends in .bin.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef PARAMETER_SWEEP_H
+#define PARAMETER_SWEEP_H
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "OdeIntegrator.h"
+#include "ThreadPool.h"
+
+// One axis of the grid, count values from min to max inclusive
+struct SweepAxis {
+    std::string name;   // sigma, rho or beta
+    double min, max;
+    int count;
+
+    double value(int i) const {
+        return count > 1 ? min + (max - min) * i / (count - 1) : min;
+    }
+};
+
+struct SweepSettings {
+    SweepAxis x = { "rho", 0.0, 200.0, 1000 };
+    SweepAxis y = { "sigma", 5.0, 20.0, 1000 };
+    double dt = 0.01;
+    int transientSteps = 1000;      // Steps discarded while the trajectory settles onto the attractor
+    int measureSteps = 5000;        // Steps the statistics are gathered over
+    int lyapunovInterval = 10;      // Steps between renormalizations of the nearby trajectory
+    int maxima = 16;                // Last z maxima kept per point
+    std::string output = "sweep.csv";
+};
+
+// Summary of one grid point
+struct SweepResult {
+    float x, y;                 // Parameter values
+    float lyapunov;             // Largest Lyapunov exponent
+    float maxMean, maxMin, maxMax;
+    uint32_t maxCount;          // Local maxima of z seen
+    std::vector<float> lastMaxima;
+};
+
+// Parses name:min:max:count, returns false if malformed
+inline bool parseSweepAxis(const char* text, SweepAxis &axis) {
+    char name[16];
+    double min, max;
+    int count;
+    if (sscanf(text, "%15[a-z]:%lf:%lf:%d", name, &min, &max, &count) != 4 || count < 1)
+        return false;
+    if (strcmp(name, "sigma") != 0 && strcmp(name, "rho") != 0 && strcmp(name, "beta") != 0)
+        return false;
+    axis.name = name;
+    axis.min = min;
+    axis.max = max;
+    axis.count = count;
+    return true;
+}
+
+// Sets the parameter an axis names
+inline void setSweepParameter(LorenzSystem &system, const SweepAxis &axis, double value) {
+    if (axis.name == "sigma") system.sigma = value;
+    else if (axis.name == "rho") system.rho = value;
+    else system.beta = value;
+}
+
+// Integrates one grid point and reduces it to its summary
+inline SweepResult sweepPoint(const SweepSettings &settings, double xValue, double yValue) {
+    LorenzSystem system;
+    setSweepParameter(system, settings.x, xValue);
+    setSweepParameter(system, settings.y, yValue);
+
+    OdeState s = { 0.01, 0.0, 0.0 };
+    for (int i = 0; i < settings.transientSteps; i++)
+        stepRK4(system, s, settings.dt);
+
+    // Nearby trajectory, kept d0 away along x by renormalization
+    const double d0 = 1e-8;
+    OdeState p = { s.x + d0, s.y, s.z };
+    double logSum = 0.0;
+
+    SweepResult result;
+    result.x = (float)xValue;
+    result.y = (float)yValue;
+    result.maxCount = 0;
+    result.maxMin = std::numeric_limits<float>::infinity();
+    result.maxMax = -std::numeric_limits<float>::infinity();
+    result.lastMaxima.assign(settings.maxima, std::numeric_limits<float>::quiet_NaN());
+    double maxSum = 0.0;
+
+    // z at the previous two steps, for spotting a local maximum
+    double z0 = s.z, z1 = s.z;
+    for (int i = 1; i <= settings.measureSteps; i++) {
+        stepRK4(system, s, settings.dt);
+        stepRK4(system, p, settings.dt);
+
+        if (i >= 2 && z1 > z0 && z1 >= s.z) {
+            // Vertex of the parabola through the last three samples
+            double denom = z0 - 2.0 * z1 + s.z;
+            double peak = denom != 0.0 ? z1 - 0.125 * (s.z - z0) * (s.z - z0) / denom : z1;
+            float value = (float)peak;
+            if (settings.maxima > 0)
+                result.lastMaxima[result.maxCount % settings.maxima] = value;
+            result.maxCount++;
+            maxSum += peak;
+            if (value < result.maxMin) result.maxMin = value;
+            if (value > result.maxMax) result.maxMax = value;
+        }
+        z0 = z1;
+        z1 = s.z;
+
+        if (i % settings.lyapunovInterval == 0) {
+            double dx = p.x - s.x, dy = p.y - s.y, dz = p.z - s.z;
+            double d = std::sqrt(dx * dx + dy * dy + dz * dz);
+            if (d > 0.0) {
+                logSum += std::log(d / d0);
+                double scale = d0 / d;
+                p.x = s.x + dx * scale; p.y = s.y + dy * scale; p.z = s.z + dz * scale;
+            }
+        }
+    }
+
+    result.lyapunov = (float)(logSum / (settings.measureSteps * settings.dt));
+    result.maxMean = result.maxCount ? (float)(maxSum / result.maxCount) : std::numeric_limits<float>::quiet_NaN();
+    if (result.maxCount == 0)
+        result.maxMin = result.maxMax = std::numeric_limits<float>::quiet_NaN();
+
+    // Oldest kept maximum first
+    if (result.maxCount > (uint32_t)settings.maxima && settings.maxima > 0) {
+        std::vector<float> ordered(settings.maxima);
+        for (int k = 0; k < settings.maxima; k++)
+            ordered[k] = result.lastMaxima[(result.maxCount + k) % settings.maxima];
+        result.lastMaxima.swap(ordered);
+    }
+    return result;
+}
+
+// Writes the file header. Binary layout: "LZSWEEP1", then int32 x count, y count, transient steps,
+// measure steps, maxima kept, then float64 dt, x min, x max, y min, y max, then the two axis names as
+// 8 byte zero padded strings, then one record per point in row order (y outer, x inner):
+// float32 x, y, lyapunov, max mean, max min, max max, uint32 max count, float32 maxima[maxima kept].
+inline void writeSweepHeader(FILE* file, const SweepSettings &settings, bool binary) {
+    if (binary) {
+        fwrite("LZSWEEP1", 1, 8, file);
+        int32_t ints[5] = { settings.x.count, settings.y.count, settings.transientSteps, settings.measureSteps, settings.maxima };
+        fwrite(ints, sizeof(ints), 1, file);
+        double doubles[5] = { settings.dt, settings.x.min, settings.x.max, settings.y.min, settings.y.max };
+        fwrite(doubles, sizeof(doubles), 1, file);
+        char names[16] = { 0 };
+        strncpy(names, settings.x.name.c_str(), 7);
+        strncpy(names + 8, settings.y.name.c_str(), 7);
+        fwrite(names, sizeof(names), 1, file);
+    }
+    else {
+        fprintf(file, "%s,%s,lyapunov,max_z_mean,max_z_min,max_z_max,max_z_count", settings.x.name.c_str(), settings.y.name.c_str());
+        for (int k = 0; k < settings.maxima; k++)
+            fprintf(file, ",max_z_%d", k);
+        fprintf(file, "\n");
+    }
+}
+
+inline void writeSweepResult(FILE* file, const SweepResult &r, bool binary) {
+    if (binary) {
+        float floats[6] = { r.x, r.y, r.lyapunov, r.maxMean, r.maxMin, r.maxMax };
+        fwrite(floats, sizeof(floats), 1, file);
+        fwrite(&r.maxCount, sizeof(r.maxCount), 1, file);
+        if (!r.lastMaxima.empty())
+            fwrite(r.lastMaxima.data(), sizeof(float), r.lastMaxima.size(), file);
+    }
+    else {
+        fprintf(file, "%g,%g,%g,%g,%g,%g,%u", r.x, r.y, r.lyapunov, r.maxMean, r.maxMin, r.maxMax, r.maxCount);
+        // Missing maxima are left empty
+        for (float m : r.lastMaxima) {
+            if (std::isnan(m)) fprintf(file, ",");
+            else fprintf(file, ",%g", m);
+        }
+        fprintf(file, "\n");
+    }
+}
+
+// Runs the whole grid on pool, writing results as each block of rows completes. Returns false on I/O failure.
+inline bool runParameterSweep(const SweepSettings &settings, ThreadPool &pool) {
+    size_t length = settings.output.size();
+    bool binary = length >= 4 && settings.output.compare(length - 4, 4, ".bin") == 0;
+    FILE* file = fopen(settings.output.c_str(), binary ? "wb" : "w");
+    if (!file) {
+        std::cerr << "Could not open " << settings.output << " for writing" << std::endl;
+        return false;
+    }
+    writeSweepHeader(file, settings, binary);
+
+    std::cout << "Sweeping " << settings.x.name << " x " << settings.y.name << ", "
+              << settings.x.count << " x " << settings.y.count << " points on " << pool.size() << " threads" << std::endl;
+
+    // Enough rows per block to keep every thread busy, few enough that memory stays small
+    int rowsPerBlock = std::max(1, (int)(pool.size() * 64 / settings.x.count));
+    std::vector<SweepResult> block;
+    auto begin = std::chrono::steady_clock::now();
+    for (int row = 0; row < settings.y.count; row += rowsPerBlock) {
+        int rows = std::min(rowsPerBlock, settings.y.count - row);
+        size_t points = (size_t)rows * settings.x.count;
+        block.resize(points);
+        pool.parallelFor(points, 16, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++) {
+                int r = row + (int)(i / settings.x.count);
+                int c = (int)(i % settings.x.count);
+                block[i] = sweepPoint(settings, settings.x.value(c), settings.y.value(r));
+            }
+        });
+        for (const SweepResult &r : block)
+            writeSweepResult(file, r, binary);
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "\r" << row + rows << "/" << settings.y.count << " rows, " << (long long)seconds << " s" << std::flush;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cout << std::endl << (long long)((double)settings.x.count * settings.y.count / seconds)
+              << " points/sec, written to " << settings.output << std::endl;
+
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+#endif
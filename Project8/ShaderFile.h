@@ -0,0 +1,75 @@
+///////////////////////////////////////////////////////////////
+// ShaderFile.h
+//
+// Builds a GLSL program from a vertex and a fragment shader file.
+// Shared by the trail renderer, the point cloud and the density image,
+// the three things drawn in the core profile window.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef SHADER_FILE_H
+#define SHADER_FILE_H
+
+#include <GL/glew.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+// Compile one shader file, returns 0 and prints the log on failure
+inline GLuint compileShaderFile(GLenum type, const char* path) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Could not open " << path << std::endl;
+        return 0;
+    }
+    std::stringstream stream;
+    stream << file.rdbuf();
+    std::string code = stream.str();
+    const char* source = code.c_str();
+
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint success;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        std::cerr << "Compiling " << path << " failed:\n" << log << std::endl;
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Compile and link both files, returns 0 and prints the log if either step fails
+inline GLuint loadShaderProgram(const char* vertexPath, const char* fragmentPath) {
+    GLuint vertex = compileShaderFile(GL_VERTEX_SHADER, vertexPath);
+    GLuint fragment = compileShaderFile(GL_FRAGMENT_SHADER, fragmentPath);
+    if (!vertex || !fragment) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    glLinkProgram(program);
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+    GLint success;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success) {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        std::cerr << "Linking " << vertexPath << " and " << fragmentPath << " failed:\n" << log << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+#endif
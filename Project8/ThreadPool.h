@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////
+// ThreadPool.h
+//
+// Small work-stealing thread pool.
+// Every worker owns a deque of tasks. A worker takes its newest task
+// from the back of its own deque and, when that runs dry, steals the
+// oldest task from the front of another worker's deque, so uneven
+// chunks even out without a central queue. Tasks are grouped in a
+// TaskGroup which can be waited on; a thread that waits helps run
+// tasks instead of sleeping.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished tasks of one batch of work
+class TaskGroup {
+public:
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class ThreadPool;
+    std::atomic<int> pending{0};
+};
+
+class ThreadPool {
+public:
+    // threads is the number of worker threads, 0 uses one per hardware thread
+    explicit ThreadPool(unsigned threads = 0) {
+        if (threads == 0) threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        for (unsigned i = 0; i < threads; i++)
+            queues.emplace_back(new WorkQueue);
+        for (unsigned i = 0; i < threads; i++)
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread &t : workers)
+            t.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    // Queue a task as part of group, returns immediately
+    void run(TaskGroup &group, std::function<void()> task) {
+        group.pending.fetch_add(1, std::memory_order_relaxed);
+        unsigned target = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+        {
+            std::lock_guard<std::mutex> lock(queues[target]->mutex);
+            queues[target]->tasks.push_back(Task{ std::move(task), &group });
+        }
+        queued.fetch_add(1, std::memory_order_release);
+        {
+            // Taking the lock orders this wake-up after a worker's check of queued
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+
+    // Block until every task of group has finished, running queued tasks in the meantime
+    void wait(TaskGroup &group) {
+        while (!group.done()) {
+            Task task;
+            if (steal(0, task))
+                execute(task);
+            else
+                std::this_thread::yield();
+        }
+    }
+
+    // Split [0, count) into chunks and call body(begin, end) for each on the pool, returns when all are done
+    template <typename Body>
+    void parallelFor(size_t count, size_t chunk, Body body) {
+        TaskGroup group;
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            size_t end = begin + chunk < count ? begin + chunk : count;
+            run(group, [=]() { body(begin, end); });
+        }
+        wait(group);
+    }
+
+private:
+    struct Task {
+        std::function<void()> function;
+        TaskGroup* group;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue{0};
+    std::atomic<int> queued{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+
+    // Newest task from our own deque
+    bool popOwn(unsigned index, Task &task) {
+        WorkQueue &queue = *queues[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) return false;
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    // Oldest task from any deque, starting the search after index
+    bool steal(unsigned index, Task &task) {
+        for (size_t i = 0; i < queues.size(); i++) {
+            WorkQueue &queue = *queues[(index + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty()) continue;
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void execute(Task &task) {
+        queued.fetch_sub(1, std::memory_order_relaxed);
+        task.function();
+        task.group->pending.fetch_sub(1, std::memory_order_release);
+    }
+
+    void workerLoop(unsigned index) {
+        for (;;) {
+            Task task;
+            if (popOwn(index, task) || steal(index + 1, task)) {
+                execute(task);
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wake.wait(lock, [this]() { return stopping || queued.load(std::memory_order_acquire) > 0; });
+            if (stopping && queued.load(std::memory_order_acquire) == 0) return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////
+// TrailBuffer.h
+//
+// Fixed capacity ring of trail points that lives in a VBO.
+// New points are staged on the CPU and uploaded once per frame with
+// glBufferSubData, so only the points added since the last frame cross
+// the bus. The trail is handed to TrailRenderer as one or two runs of
+// consecutive slots, which keeps frame time flat no matter how long
+// the program runs.
+//
+// Slot s is stored at buffer index s + 1. Index 0 mirrors the last
+// slot and the two indices past the end mirror slots 0 and 1, so every
+// segment can read the points either side of it for its joins, even
+// across the wrap.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef TRAIL_BUFFER_H
+#define TRAIL_BUFFER_H
+
+#include <GL/glew.h>
+#include <vector>
+
+// One trail point, its color is worked out in the shader
+struct TrailVertex {
+    float x, y, z;
+};
+
+// Consecutive slots drawn as one line, first slot and number of points
+struct TrailRun {
+    int first, points;
+};
+
+class TrailBuffer {
+public:
+    // Create the VBO with room for capacity points plus three mirror slots
+    void create(int capacity) {
+        this->capacity = capacity;
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, (capacity + 3) * sizeof(TrailVertex), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        clear();
+    }
+
+    // Forget every point, the VBO storage is kept
+    void clear() {
+        head = 0;
+        count = 0;
+        pending.clear();
+    }
+
+    // Stage a point
+    void append(float x, float y, float z) {
+        TrailVertex v = { x, y, z };
+        pending.push_back(v);
+    }
+
+    // Upload the points staged since the last frame, at most two glBufferSubData calls plus the mirror slots
+    void flush() {
+        if (pending.empty()) return;
+
+        // Points that would be overwritten before they are ever drawn are skipped
+        size_t skip = pending.size() > (size_t)capacity ? pending.size() - capacity : 0;
+        const TrailVertex* src = pending.data() + skip;
+        int n = (int)(pending.size() - skip);
+        head = (head + (int)skip) % capacity;
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        int first = n < capacity - head ? n : capacity - head;
+        glBufferSubData(GL_ARRAY_BUFFER, (head + 1) * sizeof(TrailVertex), first * sizeof(TrailVertex), src);
+        if (n > first)
+            glBufferSubData(GL_ARRAY_BUFFER, sizeof(TrailVertex), (n - first) * sizeof(TrailVertex), src + first);
+
+        // Refresh the mirrors of the last slot and slots 0 and 1 if this flush wrote them
+        const int mirrored[3][2] = { { capacity - 1, 0 }, { 0, capacity + 1 }, { 1, capacity + 2 } };
+        for (const auto &mirror : mirrored) {
+            int k = (mirror[0] - head + capacity) % capacity;
+            if (k < n)
+                glBufferSubData(GL_ARRAY_BUFFER, mirror[1] * sizeof(TrailVertex), sizeof(TrailVertex), src + k);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        head = (head + n) % capacity;
+        count = count + n < capacity ? count + n : capacity;
+        pending.clear();
+    }
+
+    // Runs to draw oldest to newest, returns how many. A wrapped trail is the oldest run up to the
+    // mirror of slot 0 followed by the newest run from slot 0, so the two join without a gap.
+    int runs(TrailRun out[2]) const {
+        if (count < 2) return 0;
+        if (count < capacity || head == 0) {
+            // Not wrapped yet, or wrapped exactly onto slot 0
+            out[0].first = count < capacity ? 0 : head;
+            out[0].points = count;
+            return 1;
+        }
+        out[0].first = head;
+        out[0].points = capacity - head + 1;
+        if (head < 2) return 1;
+        out[1].first = 0;
+        out[1].points = head;
+        return 2;
+    }
+
+    GLuint buffer() const { return vbo; }
+
+    // Number of points currently drawn
+    int size() const { return count; }
+
+    void destroy() {
+        glDeleteBuffers(1, &vbo);
+        vbo = 0;
+    }
+
+private:
+    GLuint vbo = 0;
+    int capacity = 0;
+    int head = 0;   // Slot the next point goes to
+    int count = 0;  // Points stored, up to capacity
+    std::vector<TrailVertex> pending;
+};
+
+#endif
@@ -0,0 +1,211 @@
+///////////////////////////////////////////////////////////////
+// TrailHistory.h
+//
+// Decimated history of a trail, for points older than the recent
+// window TrailBuffer keeps at full resolution. A point that falls out
+// of the window is streamed through a line simplifier that drops it if
+// the line drawn without it stays within a tolerance of it. The kept
+// points form level 0. When a level fills up its oldest half is
+// simplified again at twice the tolerance into the next level, so the
+// history is multi-resolution: the older the part of the trajectory,
+// the coarser it is drawn. The vertex count is set by the tolerance
+// and grows only with the log of the run time.
+//
+// The points are kept in one VBO laid out like TrailBuffer (a pad slot
+// before and after) so TrailRenderer draws the whole history as one
+// run. Each flush only uploads the part that changed, normally a few
+// vertices at the end.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef TRAIL_HISTORY_H
+#define TRAIL_HISTORY_H
+
+#include <GL/glew.h>
+#include <algorithm>
+#include <vector>
+#include "TrailBuffer.h"
+
+// Streaming simplification of a polyline. Keeps an anchor and the points after it; a new point becomes
+// the end of the current line if every point since the anchor is within tolerance of the anchor-to-point line,
+// otherwise the previous point is kept as the next anchor.
+class LineSimplifier {
+public:
+    float tolerance = 0.1f;
+    size_t maxRun = 256;    // Points held back at most, bounds the cost per point
+
+    void clear() {
+        haveAnchor = false;
+        run.clear();
+    }
+
+    // Feed the next point, points that are kept are appended to out
+    void push(const TrailVertex &p, std::vector<TrailVertex> &out) {
+        if (!haveAnchor) {
+            anchor = p;
+            haveAnchor = true;
+            out.push_back(p);
+            return;
+        }
+        if (run.size() >= maxRun || !covers(p)) {
+            anchor = run.back();
+            out.push_back(anchor);
+            run.clear();
+        }
+        run.push_back(p);
+    }
+
+    // Newest point seen but not yet kept, the line from the last kept point to it is within tolerance of every dropped point
+    bool candidate(TrailVertex &p) const {
+        if (run.empty()) return false;
+        p = run.back();
+        return true;
+    }
+
+private:
+    bool haveAnchor = false;
+    TrailVertex anchor = {};
+    std::vector<TrailVertex> run;   // Points since the anchor
+
+    // True when every point since the anchor is within tolerance of the segment from the anchor to p
+    bool covers(const TrailVertex &p) const {
+        float dx = p.x - anchor.x, dy = p.y - anchor.y, dz = p.z - anchor.z;
+        float length2 = dx * dx + dy * dy + dz * dz;
+        float limit = tolerance * tolerance;
+        for (const TrailVertex &q : run) {
+            float qx = q.x - anchor.x, qy = q.y - anchor.y, qz = q.z - anchor.z;
+            float t = length2 > 0.0f ? std::min(1.0f, std::max(0.0f, (qx * dx + qy * dy + qz * dz) / length2)) : 0.0f;
+            float ex = qx - t * dx, ey = qy - t * dy, ez = qz - t * dz;
+            if (ex * ex + ey * ey + ez * ez > limit) return false;
+        }
+        return true;
+    }
+};
+
+class TrailHistory {
+public:
+    float tolerance = 0.1f;     // Error allowed at level 0, in attractor units. Each level doubles it.
+    size_t levelCapacity = 8192; // Points a level holds before its oldest half moves down a level
+
+    // Create the VBO, window is the capacity of the TrailBuffer this history continues
+    void create(int window) {
+        this->window = window;
+        glGenBuffers(1, &vbo);
+        clear();
+    }
+
+    // Forget the whole history
+    void clear() {
+        recent.assign(window, TrailVertex());
+        recentHead = recentCount = 0;
+        levels.clear();
+        drawn.clear();
+        stable = 0;
+        dirty = true;
+    }
+
+    // Add the point the recent trail just got, the point it pushed out of the window is decimated
+    void append(float x, float y, float z) {
+        TrailVertex p = { x, y, z };
+        if (recentCount == window) {
+            decimate(recent[recentHead]);
+        }
+        else {
+            recentCount++;
+        }
+        recent[recentHead] = p;
+        recentHead = (recentHead + 1) % window;
+        dirty = true;
+    }
+
+    // Upload what changed since the last flush
+    void flush() {
+        if (!dirty) return;
+        dirty = false;
+
+        // Oldest to newest: each level's points followed by its simplifier's pending point, then the oldest
+        // point still in the recent window so the history joins the recent trail
+        drawn.assign(1, TrailVertex());
+        size_t keep = 0;
+        for (size_t k = levels.size(); k-- > 0;) {
+            drawn.insert(drawn.end(), levels[k].points.begin(), levels[k].points.end());
+            // Until the next consolidation only what follows level 0's kept points can change
+            if (k == 0) keep = drawn.size();
+            TrailVertex pending;
+            if (levels[k].simplifier.candidate(pending)) drawn.push_back(pending);
+        }
+        if (drawn.size() > 1 && recentCount == window)
+            drawn.push_back(recent[recentHead]);
+        drawn.push_back(drawn.back());
+
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        if (drawn.size() > allocated) {
+            // Grow with room to spare so appends rarely reallocate
+            allocated = drawn.size() + drawn.size() / 2 + 64;
+            glBufferData(GL_ARRAY_BUFFER, allocated * sizeof(TrailVertex), NULL, GL_DYNAMIC_DRAW);
+            stable = 0;
+        }
+        size_t first = std::min(stable, drawn.size());
+        glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(TrailVertex), (drawn.size() - first) * sizeof(TrailVertex), drawn.data() + first);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        stable = keep;
+    }
+
+    // The history as one run for TrailRenderer, returns 0 when there is nothing to draw
+    int runs(TrailRun out[1]) const {
+        if (size() < 2) return 0;
+        out[0].first = 0;
+        out[0].points = size();
+        return 1;
+    }
+
+    // Points drawn
+    int size() const { return drawn.size() > 2 ? (int)drawn.size() - 2 : 0; }
+
+    GLuint buffer() const { return vbo; }
+
+    void destroy() {
+        glDeleteBuffers(1, &vbo);
+        vbo = 0;
+    }
+
+private:
+    struct Level {
+        LineSimplifier simplifier;
+        std::vector<TrailVertex> points;   // Kept points, oldest first
+    };
+
+    GLuint vbo = 0;
+    int window = 0;
+    std::vector<TrailVertex> recent;   // Copy of the recent window, so the point leaving it is known
+    int recentHead = 0, recentCount = 0;
+    std::vector<Level> levels;         // Level 0 is the newest and finest
+    std::vector<TrailVertex> drawn;    // What the VBO holds, with a pad slot at either end
+    size_t allocated = 0;              // Vertices the VBO has room for
+    size_t stable = 0;                 // Leading vertices of drawn known to match the VBO
+    bool dirty = false;                // Points added since the last flush
+
+    // Simplify p into level 0 and move the oldest half of any full level down a level
+    void decimate(const TrailVertex &p) {
+        if (levels.empty()) addLevel();
+        levels[0].simplifier.push(p, levels[0].points);
+        for (size_t k = 0; k < levels.size() && levels[k].points.size() > levelCapacity; k++) {
+            if (k + 1 == levels.size()) addLevel();
+            std::vector<TrailVertex> &points = levels[k].points;
+            size_t half = points.size() / 2;
+            for (size_t i = 0; i < half; i++)
+                levels[k + 1].simplifier.push(points[i], levels[k + 1].points);
+            points.erase(points.begin(), points.begin() + half);
+            stable = 0;
+        }
+    }
+
+    void addLevel() {
+        Level level;
+        level.simplifier.tolerance = tolerance * (float)(1 << std::min<size_t>(levels.size(), 20));
+        levels.push_back(level);
+    }
+};
+
+#endif
@@ -0,0 +1,123 @@
+///////////////////////////////////////////////////////////////
+// TrailRenderer.h
+//
+// Draws TrailBuffer trails and their TrailHistory as thick lines with
+// a shader.
+// Each segment is one instance of a four vertex triangle strip; the
+// vertex shader projects the segment and its neighbours to the screen
+// and pushes the corners out along the miter of each joint, so lines
+// are the same width in pixels on every driver. The color from the
+// position and the fade by age are worked out in the shader too, the
+// CPU only uploads new positions.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef TRAIL_RENDERER_H
+#define TRAIL_RENDERER_H
+
+#include <GL/glew.h>
+#include "ShaderFile.h"
+#include "TrailBuffer.h"
+#include "TrailHistory.h"
+#include "ViewMatrix.h"
+
+class TrailRenderer {
+public:
+    float width = 3.0f;              // Line width in pixels
+    float colorScale = 1.0f / 30.0f; // Color channel per unit of distance from the origin, 1/30 suits the Lorenz attractor
+    float minAlpha = 0.1f;           // Alpha of the oldest point drawn
+    float historyAlpha = 0.4f;       // Alpha where a decimated history meets the recent trail
+
+    // Build the program from the shader files and the vertex array, returns false if either shader fails
+    bool create(const char* vertexPath, const char* fragmentPath) {
+        program = loadShaderProgram(vertexPath, fragmentPath);
+        if (!program) return false;
+
+        mvpLocation = glGetUniformLocation(program, "mvp");
+        viewportLocation = glGetUniformLocation(program, "viewport");
+        halfWidthLocation = glGetUniformLocation(program, "halfWidth");
+        colorScaleLocation = glGetUniformLocation(program, "colorScale");
+        alphaOldestLocation = glGetUniformLocation(program, "alphaOldest");
+        alphaNewestLocation = glGetUniformLocation(program, "alphaNewest");
+        segmentOffsetLocation = glGetUniformLocation(program, "segmentOffset");
+        segmentCountLocation = glGetUniformLocation(program, "segmentCount");
+
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
+        for (GLuint i = 0; i < 4; i++) {
+            glEnableVertexAttribArray(i);
+            glVertexAttribDivisor(i, 1);
+        }
+        glBindVertexArray(0);
+        return true;
+    }
+
+    // Set the uniforms every trail drawn this frame shares
+    void begin(const Mat4 &mvp, int viewportWidth, int viewportHeight) const {
+        glUseProgram(program);
+        glUniformMatrix4fv(mvpLocation, 1, GL_FALSE, mvp.m);
+        glUniform2f(viewportLocation, (float)viewportWidth, (float)viewportHeight);
+        glUniform1f(halfWidthLocation, 0.5f * width);
+        glUniform1f(colorScaleLocation, colorScale);
+
+        // Faded segments blend over what is behind them without hiding it
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(vao);
+    }
+
+    // Draw the recent trail, continuing from its history's fade when there is one
+    void draw(const TrailBuffer &trail, bool afterHistory = false) const {
+        TrailRun runs[2];
+        drawRuns(trail.buffer(), runs, trail.runs(runs), trail.size(), afterHistory ? historyAlpha : minAlpha, 1.0f);
+    }
+
+    // Draw the decimated history, fading out from where the recent trail starts
+    void draw(const TrailHistory &history) const {
+        TrailRun runs[1];
+        drawRuns(history.buffer(), runs, history.runs(runs), history.size(), minAlpha, historyAlpha);
+    }
+
+    // Restore the state begin changed
+    void end() const {
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glUseProgram(0);
+    }
+
+    void destroy() {
+        glDeleteVertexArrays(1, &vao);
+        glDeleteProgram(program);
+        vao = program = 0;
+    }
+
+private:
+    GLuint program = 0, vao = 0;
+    GLint mvpLocation = -1, viewportLocation = -1, halfWidthLocation = -1, colorScaleLocation = -1;
+    GLint alphaOldestLocation = -1, alphaNewestLocation = -1, segmentOffsetLocation = -1, segmentCountLocation = -1;
+
+    // One instanced draw per run, points is the total over every run
+    void drawRuns(GLuint buffer, const TrailRun* runs, int runCount, int points, float alphaOldest, float alphaNewest) const {
+        if (runCount == 0) return;
+
+        glUniform1f(alphaOldestLocation, alphaOldest);
+        glUniform1f(alphaNewestLocation, alphaNewest);
+        glUniform1i(segmentCountLocation, points - 1);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        int offset = 0;
+        for (int r = 0; r < runCount; r++) {
+            // Slot s is at buffer index s + 1, so the point before the run starts at index first
+            for (GLuint i = 0; i < 4; i++)
+                glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, sizeof(TrailVertex), (void*)((runs[r].first + i) * sizeof(TrailVertex)));
+            glUniform1i(segmentOffsetLocation, offset);
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, runs[r].points - 1);
+            offset += runs[r].points - 1;
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
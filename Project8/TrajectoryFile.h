@@ -0,0 +1,260 @@
+///////////////////////////////////////////////////////////////
+// TrajectoryFile.h
+//
+// Chunked binary recording of trajectories and memory mapped replay.
+// A file is a header naming the system, its parameters, the integrator
+// and the step size, followed by chunks of steps. Every chunk but the
+// last holds the same number of steps, so the chunk holding any step
+// is found by division and the reader never scans the file. The
+// recorder fills a chunk on the caller's thread and hands full chunks
+// to a background thread to write, so the render loop never waits on
+// the disk. A run that is killed loses at most the chunk in progress.
+//
+// Layout, native endian:
+//   header      TrajectoryHeader
+//   chunk       uint64 first step, uint32 steps, uint32 reserved,
+//               then steps records of float64 x, y, z per trajectory
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef TRAJECTORY_FILE_H
+#define TRAJECTORY_FILE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "OdeIntegrator.h"
+
+struct TrajectoryHeader {
+    char magic[8];          // "LZTRAJ01"
+    int32_t system;         // SystemType
+    int32_t integrator;     // IntegratorType
+    double dt;              // Step size before the system's timeScale
+    double params[8];       // The system's parameters in declaration order, unused ones are 0
+    int32_t trajectories;   // States stored per step
+    int32_t chunkSteps;     // Steps in every chunk but the last
+};
+
+struct TrajectoryChunkHeader {
+    uint64_t firstStep;
+    uint32_t steps;
+    uint32_t reserved;
+};
+
+// Header for a recording of the current settings of sim
+inline TrajectoryHeader trajectoryHeader(const OdeSimulation &sim, int trajectories, int chunkSteps) {
+    TrajectoryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, "LZTRAJ01", 8);
+    header.system = sim.system;
+    header.integrator = sim.integrator;
+    header.dt = sim.stepSize;
+    // Every system struct holds only its double parameters
+    withSystem(sim.system, sim.systems, [&](const auto &system) {
+        static_assert(sizeof(system) <= sizeof(header.params), "system has too many parameters to record");
+        memcpy(header.params, &system, sizeof(system));
+    });
+    header.trajectories = trajectories;
+    header.chunkSteps = chunkSteps;
+    return header;
+}
+
+class TrajectoryRecorder {
+public:
+    ~TrajectoryRecorder() { close(); }
+
+    // Start a new file and the thread that writes it, returns false if it cannot be created
+    bool open(const std::string &path, const TrajectoryHeader &header) {
+        close();
+        file = fopen(path.c_str(), "wb");
+        if (!file) {
+            std::cerr << "Could not open " << path << " for writing" << std::endl;
+            return false;
+        }
+        this->header = header;
+        this->path = path;
+        failed = fwrite(&header, sizeof(header), 1, file) != 1;
+        nextStep = 0;
+        startChunk();
+        stopping = false;
+        writer = std::thread([this]() { writeLoop(); });
+        return true;
+    }
+
+    bool isOpen() const { return file != NULL; }
+
+    // Record steps states of every trajectory, trajectories[t][i] is trajectory t after step i
+    void append(const std::vector<OdeState>* trajectories, size_t steps) {
+        if (!file) return;
+        size_t stride = header.trajectories;
+        for (size_t i = 0; i < steps; i++) {
+            for (size_t t = 0; t < stride; t++) {
+                const OdeState &s = trajectories[t][i];
+                double record[3] = { s.x, s.y, s.z };
+                chunk.insert(chunk.end(), (const char*)record, (const char*)(record + 3));
+            }
+            if (++chunkFill == (uint32_t)header.chunkSteps)
+                submitChunk();
+        }
+    }
+
+    // Write the partial chunk, wait for the writer and close the file
+    void close() {
+        if (!file) return;
+        if (chunkFill > 0)
+            submitChunk();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        writer.join();
+        if (fclose(file) != 0) failed = true;
+        if (failed)
+            std::cerr << "Writing " << path << " failed, the recording is incomplete" << std::endl;
+        else
+            std::cout << "Recorded " << nextStep << " steps to " << path << std::endl;
+        file = NULL;
+    }
+
+private:
+    FILE* file = NULL;
+    std::string path;
+    TrajectoryHeader header;
+    std::vector<char> chunk;        // Chunk being filled, header included
+    uint32_t chunkFill = 0;
+    uint64_t nextStep = 0;          // First step of the chunk being filled
+
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::vector<char>> full;   // Chunks waiting for the writer
+    bool stopping = false;
+    bool failed = false;                  // Only touched by the writer while it runs
+
+    void startChunk() {
+        chunk.clear();
+        chunk.reserve(sizeof(TrajectoryChunkHeader) + (size_t)header.chunkSteps * header.trajectories * 3 * sizeof(double));
+        chunk.resize(sizeof(TrajectoryChunkHeader));
+        chunkFill = 0;
+    }
+
+    // Fill in the chunk header and queue it for the writer
+    void submitChunk() {
+        TrajectoryChunkHeader ch = { nextStep, chunkFill, 0 };
+        memcpy(chunk.data(), &ch, sizeof(ch));
+        nextStep += chunkFill;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            full.push_back(std::move(chunk));
+        }
+        wake.notify_one();
+        chunk = std::vector<char>();
+        startChunk();
+    }
+
+    void writeLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this]() { return stopping || !full.empty(); });
+            if (full.empty()) return;
+            std::vector<char> next = std::move(full.front());
+            full.pop_front();
+            lock.unlock();
+            if (fwrite(next.data(), 1, next.size(), file) != next.size())
+                failed = true;
+            lock.lock();
+        }
+    }
+};
+
+class TrajectoryReader {
+public:
+    TrajectoryHeader header;
+
+    ~TrajectoryReader() { close(); }
+
+    // Map a recording, returns false if it is missing or not a trajectory file
+    bool open(const char* path) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Could not open " << path << std::endl;
+            return false;
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TrajectoryHeader)) {
+            std::cerr << path << " is not a trajectory file" << std::endl;
+            ::close(fd);
+            return false;
+        }
+        length = info.st_size;
+        void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            std::cerr << "Could not map " << path << std::endl;
+            return false;
+        }
+        data = (const char*)mapped;
+        memcpy(&header, data, sizeof(header));
+        if (memcmp(header.magic, "LZTRAJ01", 8) != 0 || header.system < 0 || header.system >= SYSTEM_COUNT
+            || header.integrator < 0 || header.integrator >= INTEGRATOR_COUNT || header.trajectories < 1 || header.chunkSteps < 1) {
+            std::cerr << path << " is not a trajectory file" << std::endl;
+            close();
+            return false;
+        }
+
+        // Full chunks, then whatever the last chunk holds. A chunk cut short by a crash is trimmed to its whole records.
+        recordBytes = (size_t)header.trajectories * 3 * sizeof(double);
+        chunkBytes = sizeof(TrajectoryChunkHeader) + (size_t)header.chunkSteps * recordBytes;
+        size_t body = length - sizeof(TrajectoryHeader);
+        steps = body / chunkBytes * header.chunkSteps;
+        size_t tail = body % chunkBytes;
+        if (tail > sizeof(TrajectoryChunkHeader)) {
+            TrajectoryChunkHeader ch;
+            memcpy(&ch, data + length - tail, sizeof(ch));
+            size_t present = (tail - sizeof(TrajectoryChunkHeader)) / recordBytes;
+            steps += ch.steps < present ? ch.steps : present;
+        }
+        return true;
+    }
+
+    void close() {
+        if (data) munmap((void*)data, length);
+        data = NULL;
+        steps = 0;
+    }
+
+    // Steps recorded, step 0 is the starting state
+    size_t size() const { return steps; }
+
+    // State of one trajectory after step, read straight from the mapping
+    OdeState state(int trajectory, size_t step) const {
+        size_t chunk = step / header.chunkSteps;
+        size_t offset = sizeof(TrajectoryHeader) + chunk * chunkBytes + sizeof(TrajectoryChunkHeader)
+                      + (step - chunk * header.chunkSteps) * recordBytes + trajectory * 3 * sizeof(double);
+        OdeState s;
+        memcpy(&s, data + offset, sizeof(s));
+        return s;
+    }
+
+private:
+    const char* data = NULL;
+    size_t length = 0;
+    size_t steps = 0;
+    size_t recordBytes = 0, chunkBytes = 0;
+};
+
+#endif
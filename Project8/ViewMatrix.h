@@ -0,0 +1,96 @@
+///////////////////////////////////////////////////////////////
+// ViewMatrix.h
+//
+// Column major 4x4 matrices for the camera, in the layout OpenGL and
+// GLSL expect. These replace gluPerspective, gluLookAt, glRotatef and
+// glScalef so the same matrix can be handed to the trail shader, the
+// fixed function point cloud and the density histogram.
+//
+// Jonathon Moore.
+///////////////////////////////////////////////////////////////
+
+#ifndef VIEW_MATRIX_H
+#define VIEW_MATRIX_H
+
+#include <cmath>
+
+struct Mat4 {
+    float m[16];   // m[column * 4 + row]
+
+    static Mat4 identity() {
+        Mat4 r = {};
+        r.m[0] = r.m[5] = r.m[10] = r.m[15] = 1.0f;
+        return r;
+    }
+
+    Mat4 operator*(const Mat4 &b) const {
+        Mat4 r;
+        for (int col = 0; col < 4; col++)
+            for (int row = 0; row < 4; row++) {
+                float sum = 0.0f;
+                for (int k = 0; k < 4; k++)
+                    sum += m[k * 4 + row] * b.m[col * 4 + k];
+                r.m[col * 4 + row] = sum;
+            }
+        return r;
+    }
+};
+
+// Same matrix as gluPerspective, fovy in degrees
+inline Mat4 perspectiveMatrix(float fovy, float aspect, float zNear, float zFar) {
+    float f = 1.0f / std::tan(fovy * 3.14159265f / 360.0f);
+    Mat4 r = {};
+    r.m[0] = f / aspect;
+    r.m[5] = f;
+    r.m[10] = (zFar + zNear) / (zNear - zFar);
+    r.m[11] = -1.0f;
+    r.m[14] = 2.0f * zFar * zNear / (zNear - zFar);
+    return r;
+}
+
+// Same matrix as gluLookAt
+inline Mat4 lookAtMatrix(float eyeX, float eyeY, float eyeZ, float centerX, float centerY, float centerZ, float upX, float upY, float upZ) {
+    float fx = centerX - eyeX, fy = centerY - eyeY, fz = centerZ - eyeZ;
+    float fl = std::sqrt(fx * fx + fy * fy + fz * fz);
+    fx /= fl; fy /= fl; fz /= fl;
+    // s = f x up, u = s x f
+    float sx = fy * upZ - fz * upY, sy = fz * upX - fx * upZ, sz = fx * upY - fy * upX;
+    float sl = std::sqrt(sx * sx + sy * sy + sz * sz);
+    sx /= sl; sy /= sl; sz /= sl;
+    float ux = sy * fz - sz * fy, uy = sz * fx - sx * fz, uz = sx * fy - sy * fx;
+
+    Mat4 r = Mat4::identity();
+    r.m[0] = sx; r.m[4] = sy; r.m[8] = sz;
+    r.m[1] = ux; r.m[5] = uy; r.m[9] = uz;
+    r.m[2] = -fx; r.m[6] = -fy; r.m[10] = -fz;
+    r.m[12] = -(sx * eyeX + sy * eyeY + sz * eyeZ);
+    r.m[13] = -(ux * eyeX + uy * eyeY + uz * eyeZ);
+    r.m[14] = fx * eyeX + fy * eyeY + fz * eyeZ;
+    return r;
+}
+
+// Same matrix as glRotatef about the x or y axis, angle in degrees
+inline Mat4 rotationXMatrix(float angle) {
+    float c = std::cos(angle * 3.14159265f / 180.0f), s = std::sin(angle * 3.14159265f / 180.0f);
+    Mat4 r = Mat4::identity();
+    r.m[5] = c; r.m[6] = s;
+    r.m[9] = -s; r.m[10] = c;
+    return r;
+}
+
+inline Mat4 rotationYMatrix(float angle) {
+    float c = std::cos(angle * 3.14159265f / 180.0f), s = std::sin(angle * 3.14159265f / 180.0f);
+    Mat4 r = Mat4::identity();
+    r.m[0] = c; r.m[2] = -s;
+    r.m[8] = s; r.m[10] = c;
+    return r;
+}
+
+// Same matrix as glScalef with one factor on every axis
+inline Mat4 scaleMatrix(float scale) {
+    Mat4 r = Mat4::identity();
+    r.m[0] = r.m[5] = r.m[10] = scale;
+    return r;
+}
+
+#endif
@@ -0,0 +1,9 @@
+#version 330 core
+in vec2 TexCoord; // Receives TexCoord
+out vec4 FragColor; // Returns FragColor
+
+uniform sampler2D image; // Tone mapped density, bottom row first
+
+void main() {
+    FragColor = texture(image, TexCoord);
+}
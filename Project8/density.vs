@@ -0,0 +1,9 @@
+#version 330 core
+// Four vertices with no attributes, a triangle strip over the whole viewport
+out vec2 TexCoord; // Returns TexCoord
+
+void main() {
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1); // (0,0) (1,0) (0,1) (1,1)
+    TexCoord = corner;
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+out vec4 FragColor; // Returns FragColor
+
+uniform vec3 color; // Same color for every point of the cloud
+
+void main() {
+    FragColor = vec4(color, 1.0);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+layout (location = 0) in vec3 aPos; // Ensemble point
+
+uniform mat4 mvp; // Projection * view * model
+
+void main() {
+    gl_Position = mvp * vec4(aPos, 1.0);
+}
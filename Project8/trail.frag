@@ -0,0 +1,7 @@
+#version 330 core
+in vec4 Color; // Receives Color
+out vec4 FragColor; // Returns FragColor
+
+void main() {
+    FragColor = Color;
+}
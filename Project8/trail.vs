@@ -0,0 +1,61 @@
+#version 330 core
+// One instance per trail segment, the four attributes are the same buffer read one point apart
+layout (location = 0) in vec3 aPrev; // Point before the segment
+layout (location = 1) in vec3 aStart; // Segment start
+layout (location = 2) in vec3 aEnd; // Segment end
+layout (location = 3) in vec3 aNext; // Point after the segment
+
+out vec4 Color; // Returns Color
+
+uniform mat4 mvp; // Projection * view * model
+uniform vec2 viewport; // Viewport size in pixels
+uniform float halfWidth; // Half the line width in pixels
+uniform float colorScale; // Color channel per unit of distance from the origin
+uniform float alphaOldest; // Alpha of the oldest point
+uniform float alphaNewest; // Alpha of the newest point
+uniform int segmentOffset; // Segments drawn before this run
+uniform int segmentCount; // Segments in the whole trail
+
+// Clip space to pixels from the center of the viewport
+vec2 toScreen(vec4 clip) {
+    return clip.xy / clip.w * 0.5 * viewport;
+}
+
+// Unit direction from a to b, or fallback when they land on the same pixel
+vec2 direction(vec2 a, vec2 b, vec2 fallback) {
+    vec2 d = b - a;
+    float len = length(d);
+    return len > 1e-4 ? d / len : fallback;
+}
+
+void main() {
+    int segment = segmentOffset + gl_InstanceID;
+    bool atEnd = gl_VertexID >= 2; // Vertices 0 and 1 sit at the start, 2 and 3 at the end
+    float side = (gl_VertexID & 1) == 0 ? -1.0 : 1.0;
+
+    vec4 clipStart = mvp * vec4(aStart, 1.0);
+    vec4 clipEnd = mvp * vec4(aEnd, 1.0);
+    vec2 start = toScreen(clipStart);
+    vec2 end = toScreen(clipEnd);
+    vec2 dir = direction(start, end, vec2(1.0, 0.0));
+    vec2 normal = vec2(-dir.y, dir.x);
+
+    // The miter at a joint bisects the two segments meeting there, the ends of the trail are square
+    vec2 tangent = dir;
+    if (!atEnd && segment > 0)
+        tangent = direction(vec2(0.0), direction(toScreen(mvp * vec4(aPrev, 1.0)), start, dir) + dir, dir);
+    if (atEnd && segment < segmentCount - 1)
+        tangent = direction(vec2(0.0), dir + direction(end, toScreen(mvp * vec4(aNext, 1.0)), dir), dir);
+    vec2 miter = vec2(-tangent.y, tangent.x);
+    // The miter gets longer as the joint gets sharper, capped so hairpin turns do not spike
+    float len = halfWidth / max(dot(miter, normal), 0.25);
+
+    vec4 clip = atEnd ? clipEnd : clipStart;
+    clip.xy += miter * len * side / (0.5 * viewport) * clip.w;
+    gl_Position = clip;
+
+    // Same color as the old per vertex glColor3f, faded by age
+    vec3 pos = atEnd ? aEnd : aStart;
+    float age = float(segment + (atEnd ? 1 : 0)) / float(segmentCount);
+    Color = vec4(clamp(abs(pos) * colorScale, 0.0, 1.0), mix(alphaOldest, alphaNewest, age));
+}